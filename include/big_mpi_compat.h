@@ -10,7 +10,72 @@
 // required for std::numeric_limits used below.
 #include <mpi.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <limits>
+#include <map>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#  define MPI_COMPAT_HAVE_SSE42_CRC32C
+#  include <nmmintrin.h>
+#endif
+
+#ifdef MPI_COMPAT_WITH_PROGRESS_THREAD
+#  include <chrono>
+#  include <condition_variable>
+#  include <mutex>
+#  ifdef __linux__
+#    include <pthread.h>
+#    include <sched.h>
+#  endif
+
+/**
+ * Shortest and longest time in microseconds the progress thread sleeps
+ * between two polls of the outstanding requests.
+ */
+#  ifndef MPI_COMPAT_PROGRESS_MIN_BACKOFF_US
+#    define MPI_COMPAT_PROGRESS_MIN_BACKOFF_US 10
+#  endif
+#  ifndef MPI_COMPAT_PROGRESS_MAX_BACKOFF_US
+#    define MPI_COMPAT_PROGRESS_MAX_BACKOFF_US 1000
+#  endif
+#endif
+#ifdef MPI_COMPAT_WITH_TRACING
+#  include <cstdio>
+#  include <string>
+
+/**
+ * Number of events the trace of every process keeps by default, see
+ * Trace_start().
+ */
+#  ifndef MPI_COMPAT_TRACE_CAPACITY
+#    define MPI_COMPAT_TRACE_CAPACITY (1 << 16)
+#  endif
+
+#  define MPI_COMPAT_TRACE_CONCAT_IMPL(a, b) a##b
+#  define MPI_COMPAT_TRACE_CONCAT(a, b) MPI_COMPAT_TRACE_CONCAT_IMPL(a, b)
+
+/**
+ * Record the time from here to the end of the enclosing scope as an event
+ * called @p name (a string literal) in the trace.
+ *
+ * This changes the bodies of the inline functions of this file, so
+ * MPI_COMPAT_WITH_TRACING has to be defined in all translation units of a
+ * program or in none.
+ */
+#  define MPI_COMPAT_TRACE_SCOPE(name)                          \
+    BigMPICompat::internal::TraceScope MPI_COMPAT_TRACE_CONCAT( \
+      trace_scope_, __LINE__)(name)
+#else
+#  define MPI_COMPAT_TRACE_SCOPE(name)
+#endif
 #ifndef MPI_VERSION
 #  error "Your MPI implementation does not define MPI_VERSION!"
 #endif
@@ -19,6 +84,11 @@
 #  error "BigMPICompat requires at least MPI 3.0"
 #endif
 
+// nonblocking collective file access was added in MPI 3.1
+#if MPI_VERSION > 3 || MPI_SUBVERSION >= 1
+#  define MPI_COMPAT_HAVE_NONBLOCKING_COLLECTIVE_IO
+#endif
+
 /**
  * This namespace contains symbols related to the BigMPICompat library
  * to support large MPI routines on MPI implementations that implement
@@ -29,92 +99,543 @@ namespace BigMPICompat
   /**
    * This is the largest @p count supported when it is represented
    * with a signed integer (old MPI routines).
+   *
+   * The tests define MPI_COMPAT_MAX_INT_COUNT to a much smaller value to
+   * run through the code paths for large counts with small buffers. Do not
+   * define it in applications.
    */
   static constexpr MPI_Count mpi_max_int_count =
+#ifdef MPI_COMPAT_MAX_INT_COUNT
+    MPI_COMPAT_MAX_INT_COUNT;
+#else
     std::numeric_limits<int>::max();
+#endif
+
+#ifdef MPI_COMPAT_WITH_TRACING
+  namespace internal
+  {
+    /**
+     * A timed event in the trace, see MPI_COMPAT_TRACE_SCOPE.
+     */
+    struct TraceEvent
+    {
+      const char *name;
+      double      begin;
+      double      end;
+      int         thread;
+    };
+
+    /**
+     * The trace of this process: a ring buffer of events that is allocated
+     * in Trace_start(), so that recording an event never allocates. Once it
+     * is full, the oldest events are overwritten.
+     */
+    struct TraceBuffer
+    {
+      /**
+       * Read by every thread that records an event, so it is atomic.
+       */
+      std::atomic<bool>          enabled{false};
+      std::vector<TraceEvent>    events;
+      std::atomic<std::uint64_t> n_recorded{0};
+
+      /**
+       * Number of threads that are recording an event right now. Writing
+       * the trace waits until it drops to zero after disabling it.
+       */
+      std::atomic<int> n_writers{0};
+
+      /**
+       * MPI_Wtime() at the synchronized start of the trace.
+       */
+      double start_time = 0;
+
+      /**
+       * Duplicate of the communicator passed to Trace_start(), and the file
+       * the traces of all its processes are written to.
+       */
+      MPI_Comm    comm = MPI_COMM_NULL;
+      std::string filename;
+
+      /**
+       * Keyval of the attribute on MPI_COMM_SELF that writes the trace at
+       * the beginning of MPI_Finalize().
+       */
+      int keyval = MPI_KEYVAL_INVALID;
+    };
+
+    inline TraceBuffer &
+    trace_buffer()
+    {
+      static TraceBuffer buffer;
+      return buffer;
+    }
+
+    /**
+     * Return a small number identifying the calling thread in the trace.
+     */
+    inline int
+    trace_thread_id()
+    {
+      static std::atomic<int> next_id{0};
+      static thread_local int id = next_id++;
+      return id;
+    }
+
+    /**
+     * Records its lifetime as an event, see MPI_COMPAT_TRACE_SCOPE.
+     */
+    class TraceScope
+    {
+    public:
+      explicit TraceScope(const char *name)
+        : name(name)
+        , begin(trace_buffer().enabled ? MPI_Wtime() : -1.)
+      {}
+
+      ~TraceScope()
+      {
+        TraceBuffer &buffer = trace_buffer();
+        if (begin < 0)
+          return;
+
+        // announce the write before checking that tracing is still on, so
+        // that trace_write() either sees the writer or the writer sees
+        // tracing disabled
+        ++buffer.n_writers;
+        if (buffer.enabled)
+          {
+            const std::uint64_t index = buffer.n_recorded++;
+            buffer.events[index % buffer.events.size()] = {name,
+                                                           begin,
+                                                           MPI_Wtime(),
+                                                           trace_thread_id()};
+          }
+        --buffer.n_writers;
+      }
+
+      TraceScope(const TraceScope &) = delete;
+      TraceScope &
+      operator=(const TraceScope &) = delete;
+
+    private:
+      const char * name;
+      const double begin;
+    };
+  } // namespace internal
+#endif
 
   /**
-   * Create a contiguous type of (possibly large) @p count.
-   *
-   * See the MPI 4.x standard for details.
+   * Ways to build the datatype for a large count in Type_contiguous_c()
+   * without native support. MPI implementations differ in how well they
+   * pack, register and pipeline the different shapes, so the best choice
+   * depends on the MPI stack; see Type_benchmark_strategies().
+   */
+  enum class TypeStrategy
+  {
+    /**
+     * MPI_Type_contiguous_c() with MPI 4.x, vector_struct otherwise. This
+     * is the default.
+     */
+    standard,
+    /**
+     * An MPI_Type_vector() of blocks of mpi_max_int_count elements and a
+     * contiguous remainder, combined with MPI_Type_create_struct().
+     */
+    vector_struct,
+    /**
+     * Like vector_struct, but the blocks have the largest power of two of
+     * elements not larger than mpi_max_int_count.
+     */
+    power_of_two,
+    /**
+     * MPI_Type_create_hindexed() of as few blocks of (almost) equal size
+     * as possible.
+     */
+    hindexed,
+    /**
+     * Like vector_struct, but of MPI_BYTE if the old type is contiguous
+     * (otherwise vector_struct is used). This changes the type signature,
+     * so the peers of a communication have to use a byte signature as
+     * well, for example by selecting this strategy on all processes. It
+     * can not be used for reductions.
+     *
+     * Counts up to mpi_max_int_count still give MPI_Type_contiguous() of
+     * the old type, so the signature depends on the count: both sides of
+     * a communication have to pass counts on the same side of that limit.
+     * The messages that node aggregated collectives send between nodes
+     * always use the standard strategy, so they are not affected.
+     */
+    bytes
+  };
+
+  /**
+   * The cost of a datatype built by Type_contiguous_c() with a certain
+   * strategy.
+   */
+  struct TypeCost
+  {
+    TypeStrategy strategy = TypeStrategy::standard;
+
+    /**
+     * Time in seconds to create and commit the datatype.
+     */
+    double construction_seconds = 0;
+
+    /**
+     * Number of contiguous blocks the datatype is described by, and the
+     * number of derived datatypes created for it.
+     */
+    MPI_Count n_blocks    = 0;
+    int       n_datatypes = 0;
+
+    /**
+     * Time in seconds to copy the data with this datatype from one buffer
+     * to another through MPI, measured by Type_benchmark_strategies().
+     */
+    double transfer_seconds = 0;
+  };
+
+  namespace internal
+  {
+    /**
+     * Return the strategy used by Type_contiguous_c() if none is given.
+     */
+    inline TypeStrategy &
+    type_strategy()
+    {
+      static TypeStrategy strategy = TypeStrategy::standard;
+      return strategy;
+    }
+
+    /**
+     * Compute the size in bytes of @p count elements of @p datatype and
+     * store it in @p n_bytes. Returns MPI_ERR_TYPE if the datatype is not
+     * contiguous, for the functions that work on the raw memory.
+     */
+    inline int
+    contiguous_bytes(MPI_Count    count,
+                     MPI_Datatype datatype,
+                     MPI_Count *  n_bytes)
+    {
+      int       ierr;
+      MPI_Count size, lb, extent, true_lb, true_extent;
+      ierr = MPI_Type_size_x(datatype, &size);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      ierr = MPI_Type_get_extent_x(datatype, &lb, &extent);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      ierr = MPI_Type_get_true_extent_x(datatype, &true_lb, &true_extent);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      if (lb != 0 || true_lb != 0 || extent != size || true_extent != size)
+        return MPI_ERR_TYPE;
+
+      *n_bytes = count * size;
+      return MPI_SUCCESS;
+    }
+
+    /**
+     * Create an MPI_Type_vector() of blocks of @p block elements and a
+     * contiguous remainder, combined with MPI_Type_create_struct().
+     */
+    inline int
+    type_vector_struct(MPI_Count     count,
+                       MPI_Datatype  oldtype,
+                       MPI_Count     block,
+                       MPI_Datatype *newtype,
+                       TypeCost *    cost)
+    {
+      int ierr;
+
+      MPI_Count size_old;
+      ierr = MPI_Type_size_x(oldtype, &size_old);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      MPI_Count n_chunks             = count / block;
+      MPI_Count n_remaining_elements = count % block;
+
+      MPI_Datatype chunks;
+      ierr = MPI_Type_vector(n_chunks, block, block, oldtype, &chunks);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      MPI_Datatype remainder;
+      ierr = MPI_Type_contiguous(n_remaining_elements, oldtype, &remainder);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      int          blocklengths[2]  = {1, 1};
+      MPI_Aint     displacements[2] = {0,
+                                   static_cast<MPI_Aint>(n_chunks) *
+                                     size_old * block};
+      MPI_Datatype types[2]         = {chunks, remainder};
+      ierr                          = MPI_Type_create_struct(
+        2, blocklengths, displacements, types, newtype);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      ierr = MPI_Type_free(&chunks);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      ierr = MPI_Type_free(&remainder);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      if (cost != nullptr)
+        {
+          cost->n_blocks    = n_chunks + (n_remaining_elements > 0 ? 1 : 0);
+          cost->n_datatypes = 3;
+        }
+      return MPI_SUCCESS;
+    }
+
+    /**
+     * Create an MPI_Type_create_hindexed() of the fewest blocks of at most
+     * mpi_max_int_count elements, with sizes that differ by at most one
+     * element.
+     */
+    inline int
+    type_hindexed(MPI_Count     count,
+                  MPI_Datatype  oldtype,
+                  MPI_Datatype *newtype,
+                  TypeCost *    cost)
+    {
+      MPI_Aint  lb, extent;
+      const int ierr = MPI_Type_get_extent(oldtype, &lb, &extent);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      const MPI_Count n_blocks =
+        (count + BigMPICompat::mpi_max_int_count - 1) /
+        BigMPICompat::mpi_max_int_count;
+      std::vector<int>      blocklengths(n_blocks);
+      std::vector<MPI_Aint> displacements(n_blocks);
+      MPI_Count             first = 0;
+      for (MPI_Count i = 0; i < n_blocks; ++i)
+        {
+          blocklengths[i]  = count / n_blocks + (i < count % n_blocks ? 1 : 0);
+          displacements[i] = first * extent;
+          first += blocklengths[i];
+        }
+
+      if (cost != nullptr)
+        {
+          cost->n_blocks    = n_blocks;
+          cost->n_datatypes = 1;
+        }
+      return MPI_Type_create_hindexed(n_blocks,
+                                      blocklengths.data(),
+                                      displacements.data(),
+                                      oldtype,
+                                      newtype);
+    }
+  } // namespace internal
+
+  /**
+   * Select the strategy Type_contiguous_c() uses to build datatypes if no
+   * strategy is passed to it. This affects all functions in this namespace
+   * that create large datatypes and has to be the same on all processes.
+   */
+  inline void
+  Type_set_strategy(TypeStrategy strategy)
+  {
+    internal::type_strategy() = strategy;
+  }
+
+  /**
+   * Return the strategy selected with Type_set_strategy().
+   */
+  inline TypeStrategy
+  Type_get_strategy()
+  {
+    return internal::type_strategy();
+  }
+
+  /**
+   * Like Type_contiguous_c() below, but build a large type with the given
+   * @p strategy and return its cost in @p cost if that is not nullptr.
    */
   inline int
   Type_contiguous_c(MPI_Count     count,
                     MPI_Datatype  oldtype,
-                    MPI_Datatype *newtype)
+                    MPI_Datatype *newtype,
+                    TypeStrategy  strategy,
+                    TypeCost *    cost = nullptr)
   {
-#if MPI_VERSION >= 4
-    return MPI_Type_contiguous_c(count, oldtype, newtype);
-#else
-    if (count <= BigMPICompat::mpi_max_int_count)
-      return MPI_Type_contiguous(count, oldtype, newtype);
-    else
+    MPI_COMPAT_TRACE_SCOPE("Type_contiguous_c");
+    const double start = MPI_Wtime();
+    if (cost != nullptr)
       {
-        int             ierr;
-        const MPI_Count max_signed_int = BigMPICompat::mpi_max_int_count;
-
-        MPI_Count size_old;
-        ierr = MPI_Type_size_x(oldtype, &size_old);
-
-        MPI_Count n_chunks             = count / max_signed_int;
-        MPI_Count n_remaining_elements = count % max_signed_int;
+        *cost          = TypeCost();
+        cost->strategy = strategy;
+      }
 
-        MPI_Datatype chunks;
-        ierr = MPI_Type_vector(
-          n_chunks, max_signed_int, max_signed_int, oldtype, &chunks);
+    int ierr;
+    if (strategy == TypeStrategy::standard)
+      {
+#if MPI_VERSION >= 4
+        ierr = MPI_Type_contiguous_c(count, oldtype, newtype);
         if (ierr != MPI_SUCCESS)
           return ierr;
-
-        MPI_Datatype remainder;
-        ierr = MPI_Type_contiguous(n_remaining_elements, oldtype, &remainder);
+        if (cost != nullptr)
+          {
+            cost->n_blocks    = 1;
+            cost->n_datatypes = 1;
+          }
+        ierr = MPI_Type_commit(newtype);
         if (ierr != MPI_SUCCESS)
           return ierr;
+        if (cost != nullptr)
+          cost->construction_seconds = MPI_Wtime() - start;
+        return MPI_SUCCESS;
+#else
+        strategy = TypeStrategy::vector_struct;
+#endif
+      }
 
-        int          blocklengths[2]  = {1, 1};
-        MPI_Aint     displacements[2] = {0,
-                                     static_cast<MPI_Aint>(n_chunks) *
-                                       size_old * max_signed_int};
-        MPI_Datatype types[2]         = {chunks, remainder};
-        ierr                          = MPI_Type_create_struct(
-          2, blocklengths, displacements, types, newtype);
+    if (count <= BigMPICompat::mpi_max_int_count)
+      {
+        ierr = MPI_Type_contiguous(count, oldtype, newtype);
         if (ierr != MPI_SUCCESS)
           return ierr;
-
-        ierr = MPI_Type_commit(newtype);
+        if (cost != nullptr)
+          {
+            cost->n_blocks    = 1;
+            cost->n_datatypes = 1;
+          }
+      }
+    else
+      {
+        MPI_Count n_bytes;
+        if (strategy == TypeStrategy::bytes &&
+            internal::contiguous_bytes(count, oldtype, &n_bytes) ==
+              MPI_SUCCESS)
+          ierr = internal::type_vector_struct(n_bytes,
+                                              MPI_BYTE,
+                                              BigMPICompat::mpi_max_int_count,
+                                              newtype,
+                                              cost);
+        else if (strategy == TypeStrategy::power_of_two)
+          {
+            MPI_Count block = 1;
+            while (2 * block <= BigMPICompat::mpi_max_int_count)
+              block *= 2;
+            ierr = internal::type_vector_struct(
+              count, oldtype, block, newtype, cost);
+          }
+        else if (strategy == TypeStrategy::hindexed)
+          ierr = internal::type_hindexed(count, oldtype, newtype, cost);
+        else
+          ierr = internal::type_vector_struct(count,
+                                              oldtype,
+                                              BigMPICompat::mpi_max_int_count,
+                                              newtype,
+                                              cost);
         if (ierr != MPI_SUCCESS)
           return ierr;
+      }
+
+    ierr = MPI_Type_commit(newtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    if (cost != nullptr)
+      cost->construction_seconds = MPI_Wtime() - start;
+
+#ifndef MPI_COMPAT_SKIP_SIZE_CHECK
+    MPI_Count size_old, size_new;
+    ierr = MPI_Type_size_x(oldtype, &size_old);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = MPI_Type_size_x(*newtype, &size_new);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    if (size_old * count != size_new)
+      {
+        // This error can happen when you are using a very old and
+        // buggy MPI implementation. There is nothing we can do
+        // here, unfortunately. Please update your installation.
+        return MPI_ERR_INTERN;
+      }
+#endif
 
-        ierr = MPI_Type_free(&chunks);
+    return MPI_SUCCESS;
+  }
+
+  /**
+   * Create a contiguous type of (possibly large) @p count, using the
+   * strategy selected with Type_set_strategy().
+   *
+   * Unlike MPI_Type_contiguous_c(), the new type is committed already and
+   * can be used for communication right away; only MPI_Type_free() is left
+   * to the caller. All functions in this namespace rely on this.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Type_contiguous_c(MPI_Count     count,
+                    MPI_Datatype  oldtype,
+                    MPI_Datatype *newtype)
+  {
+    return Type_contiguous_c(count, oldtype, newtype, Type_get_strategy());
+  }
+
+  /**
+   * Build the datatype for @p count elements of @p oldtype with every
+   * strategy and measure in @p costs how long it takes to construct it and
+   * to copy @p sendbuf to @p recvbuf with it through MPI_COMM_SELF, which
+   * shows the cost of the datatype engine of the MPI implementation. Pick
+   * the fastest strategy with Type_set_strategy() on all processes.
+   */
+  inline int
+  Type_benchmark_strategies(const void *           sendbuf,
+                            void *                 recvbuf,
+                            MPI_Count              count,
+                            MPI_Datatype           oldtype,
+                            std::vector<TypeCost> &costs)
+  {
+    const TypeStrategy strategies[] = {TypeStrategy::standard,
+                                       TypeStrategy::vector_struct,
+                                       TypeStrategy::power_of_two,
+                                       TypeStrategy::hindexed,
+                                       TypeStrategy::bytes};
+    costs.clear();
+    for (const TypeStrategy strategy : strategies)
+      {
+        TypeCost     cost;
+        MPI_Datatype type;
+        int ierr = Type_contiguous_c(count, oldtype, &type, strategy, &cost);
         if (ierr != MPI_SUCCESS)
           return ierr;
 
-        ierr = MPI_Type_free(&remainder);
+        const double start = MPI_Wtime();
+        ierr               = MPI_Sendrecv(sendbuf,
+                            1,
+                            type,
+                            0,
+                            0,
+                            recvbuf,
+                            1,
+                            type,
+                            0,
+                            0,
+                            MPI_COMM_SELF,
+                            MPI_STATUS_IGNORE);
         if (ierr != MPI_SUCCESS)
           return ierr;
+        cost.transfer_seconds = MPI_Wtime() - start;
 
-#  ifndef MPI_COMPAT_SKIP_SIZE_CHECK
-        MPI_Count size_new;
-        ierr = MPI_Type_size_x(*newtype, &size_new);
+        ierr = MPI_Type_free(&type);
         if (ierr != MPI_SUCCESS)
           return ierr;
-
-        if (size_old * count != size_new)
-          {
-            // This error can happen when you are using a very old and
-            // buggy MPI implementation. There is nothing we can do
-            // here, unfortunately. Please update your installation.
-            //	  std::cerr
-            //<< "MPI_Type_contiguous_c() produced an invalid result. Expected =
-            //"
-            //<< size_old << " * " << count << " = " << size_old * count
-            //<< " but received " << size_new << std::endl;
-            return MPI_ERR_INTERN;
-          }
-#  endif
-
-        return MPI_SUCCESS;
+        costs.push_back(cost);
       }
-#endif
+    return MPI_SUCCESS;
   }
 
 
@@ -131,6 +652,7 @@ namespace BigMPICompat
          int          tag,
          MPI_Comm     comm)
   {
+    MPI_COMPAT_TRACE_SCOPE("Send_c");
 #if MPI_VERSION >= 4
     return MPI_Send_c(buf, count, datatype, dest, tag, comm);
 #else
@@ -140,9 +662,6 @@ namespace BigMPICompat
     MPI_Datatype bigtype;
     int          ierr;
     ierr = Type_contiguous_c(count, datatype, &bigtype);
-    if (ierr != MPI_SUCCESS)
-      return ierr;
-    ierr = MPI_Type_commit(&bigtype);
     if (ierr != MPI_SUCCESS)
       return ierr;
 
@@ -171,6 +690,7 @@ namespace BigMPICompat
          MPI_Comm     comm,
          MPI_Status * status)
   {
+    MPI_COMPAT_TRACE_SCOPE("Recv_c");
 #if MPI_VERSION >= 4
     return MPI_Recv_c(buf, count, datatype, source, tag, comm, status);
 #else
@@ -183,10 +703,6 @@ namespace BigMPICompat
     if (ierr != MPI_SUCCESS)
       return ierr;
 
-    ierr = MPI_Type_commit(&bigtype);
-    if (ierr != MPI_SUCCESS)
-      return ierr;
-
     ierr = MPI_Recv(buf, 1, bigtype, source, tag, comm, status);
     if (ierr != MPI_SUCCESS)
       return ierr;
@@ -211,6 +727,7 @@ namespace BigMPICompat
           unsigned int root_mpi_rank,
           MPI_Comm     comm)
   {
+    MPI_COMPAT_TRACE_SCOPE("Bcast_c");
 #if MPI_VERSION >= 4
     return MPI_Bcast_c(buf, count, datatype, root_mpi_rank, comm);
 #else
@@ -220,9 +737,6 @@ namespace BigMPICompat
     MPI_Datatype bigtype;
     int          ierr;
     ierr = Type_contiguous_c(count, datatype, &bigtype);
-    if (ierr != MPI_SUCCESS)
-      return ierr;
-    ierr = MPI_Type_commit(&bigtype);
     if (ierr != MPI_SUCCESS)
       return ierr;
 
@@ -237,174 +751,1066 @@ namespace BigMPICompat
 #endif
   }
 
+  namespace internal
+  {
+    /**
+     * State of the ring of Iallgather_c() without native support. The
+     * messages are posted in the same order as in the ring of
+     * Allgather_c(), one segment after the other and step after step, but
+     * a segment is only forwarded in the next step once its receive and
+     * send of the previous step completed. So at most one receive and one
+     * send per segment are in flight, independent of the number of
+     * processes.
+     */
+    struct AllgatherRing
+    {
+      char *       data       = nullptr;
+      MPI_Count    recvcount  = 0;
+      MPI_Datatype recvtype   = MPI_DATATYPE_NULL;
+      MPI_Aint     extent     = 0;
+      MPI_Count    segment    = 0;
+      MPI_Count    n_segments = 0;
+      int          myid       = 0;
+      int          n_ranks    = 0;
+      MPI_Comm     comm       = MPI_COMM_NULL;
+      int          tag        = 0;
+
+      /**
+       * The step and segment whose messages are posted next.
+       */
+      int       step         = 0;
+      MPI_Count next_segment = 0;
+
+      /**
+       * The latest receive and send of every segment.
+       */
+      std::vector<MPI_Request> receives;
+      std::vector<MPI_Request> sends;
+    };
+
+    /**
+     * Post all messages of @p ring whose previous step completed, and set
+     * @p done once all messages completed. The messages are at most
+     * allgather_segment_bytes, so they are posted with plain int counts.
+     */
+    inline int
+    advance_allgather_ring(AllgatherRing &ring, int *done)
+    {
+      int ierr;
+      *done = 0;
+      while (ring.step < ring.n_ranks - 1)
+        {
+          const MPI_Count k = ring.next_segment;
+          for (MPI_Request *previous : {&ring.receives[k], &ring.sends[k]})
+            {
+              int flag;
+              ierr = MPI_Test(previous, &flag, MPI_STATUS_IGNORE);
+              if (ierr != MPI_SUCCESS)
+                return ierr;
+              if (!flag)
+                return MPI_SUCCESS;
+            }
+
+          const int right = (ring.myid + 1) % ring.n_ranks;
+          const int left  = (ring.myid + ring.n_ranks - 1) % ring.n_ranks;
+          const MPI_Count send_block =
+            (ring.myid + ring.n_ranks - ring.step) % ring.n_ranks;
+          const MPI_Count recv_block =
+            (ring.myid + ring.n_ranks - ring.step - 1) % ring.n_ranks;
+          const MPI_Count first = k * ring.segment;
+          const int       count =
+            static_cast<int>(std::min(ring.segment, ring.recvcount - first));
+          char *recv_data =
+            ring.data + (recv_block * ring.recvcount + first) * ring.extent;
+          char *send_data =
+            ring.data + (send_block * ring.recvcount + first) * ring.extent;
+
+          ierr = MPI_Irecv(recv_data,
+                           count,
+                           ring.recvtype,
+                           left,
+                           ring.tag,
+                           ring.comm,
+                           &ring.receives[k]);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+          ierr = MPI_Isend(send_data,
+                           count,
+                           ring.recvtype,
+                           right,
+                           ring.tag,
+                           ring.comm,
+                           &ring.sends[k]);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+
+          if (++ring.next_segment == ring.n_segments)
+            {
+              ring.next_segment = 0;
+              ++ring.step;
+            }
+        }
+
+      for (std::vector<MPI_Request> *requests : {&ring.receives, &ring.sends})
+        {
+          int flag;
+          ierr = MPI_Testall(requests->size(),
+                             requests->data(),
+                             &flag,
+                             MPI_STATUSES_IGNORE);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+          if (!flag)
+            return MPI_SUCCESS;
+        }
+      *done = 1;
+      return MPI_SUCCESS;
+    }
+
+    /**
+     * Additional data BigMPICompat needs to keep for a request it created,
+     * for example a derived datatype that has to live as long as a
+     * persistent request.
+     */
+    struct RequestData
+    {
+      /**
+       * Large datatype owned by the request, freed in Request_free().
+       */
+      MPI_Datatype bigtype = MPI_DATATYPE_NULL;
+
+      /**
+       * Arguments of an emulated persistent broadcast. MPI 3.x has no
+       * persistent collectives, so Start() calls MPI_Ibcast() with these
+       * and stores the resulting request in @p active.
+       */
+      bool         is_bcast = false;
+      void *       buf      = nullptr;
+      int          count    = 0;
+      MPI_Datatype datatype = MPI_DATATYPE_NULL;
+      int          root     = 0;
+      MPI_Comm     comm     = MPI_COMM_NULL;
+      MPI_Request  active   = MPI_REQUEST_NULL;
+
+      /**
+       * Argument arrays of a nonblocking collective that have to stay valid
+       * until it completes. They are released in Test() or Wait().
+       */
+      bool                      release_on_completion = false;
+      std::vector<int>          counts;
+      std::vector<MPI_Aint>     displs;
+      std::vector<MPI_Datatype> types;
+
+      /**
+       * Ring of an emulated Iallgather_c(). The request of the user is then
+       * an inactive placeholder that is freed once the ring completed in
+       * Test() or Wait(). The ring is shared with the progress thread,
+       * which advances it in the background.
+       */
+      std::shared_ptr<AllgatherRing> ring;
+
+      /**
+       * Persistent requests of the partitions of an emulated partitioned
+       * send or receive. The request of the user is then an inactive
+       * placeholder. Start() starts all partitions of a receive, while the
+       * partitions of a send are started one by one in Pready().
+       */
+      std::vector<MPI_Request> partitions;
+      bool                     is_precv = false;
+
+      /**
+       * Number of partitions started since the last Start(), counted by
+       * Pready() after it started one. Test() and Wait() only touch the
+       * partitions once all of them are started, because other threads
+       * may still be starting them.
+       */
+      std::shared_ptr<std::atomic<int>> n_started;
+    };
+
+    /**
+     * Return the map from requests created by BigMPICompat to their
+     * additional data. Requests without additional data are not stored.
+     */
+    inline std::map<MPI_Request, RequestData> &
+    request_data()
+    {
+      static std::map<MPI_Request, RequestData> data;
+      return data;
+    }
+
+#ifdef MPI_COMPAT_WITH_PROGRESS_THREAD
+    /**
+     * State of the optional background thread that drives the progress of
+     * outstanding nonblocking operations, see Progress_start().
+     */
+    struct ProgressEngine
+    {
+      std::mutex              mutex;
+      std::condition_variable wake_up;
+      std::thread             thread;
+      bool                    running  = false;
+      bool                    stop     = false;
+      bool                    new_work = false;
+
+      /**
+       * Outstanding requests the thread drives the progress of. They are
+       * only compared, never passed to MPI, because the application may
+       * have completed and freed one with MPI_Test() or MPI_Wait() already,
+       * and its handle may even have been reused. A request is removed in
+       * Test() and Wait(), so the thread stops polling once all are done.
+       */
+      std::vector<MPI_Request> requests;
+
+      /**
+       * Rings of Iallgather_c() the thread currently advances, under the
+       * same rules as @p requests.
+       */
+      std::vector<std::shared_ptr<AllgatherRing>> rings;
+
+      /**
+       * Keyval of the attribute on MPI_COMM_SELF that stops the thread at
+       * the beginning of MPI_Finalize().
+       */
+      int keyval = MPI_KEYVAL_INVALID;
+    };
+
+    inline ProgressEngine &
+    progress_engine()
+    {
+      static ProgressEngine engine;
+      return engine;
+    }
+
+    /**
+     * Main loop of the progress thread. Polling backs off exponentially
+     * from MPI_COMPAT_PROGRESS_MIN_BACKOFF_US to
+     * MPI_COMPAT_PROGRESS_MAX_BACKOFF_US while nothing completes and blocks
+     * completely while there is no work.
+     */
+    inline void
+    progress_loop()
+    {
+      const std::chrono::microseconds min_backoff(
+        MPI_COMPAT_PROGRESS_MIN_BACKOFF_US);
+      const std::chrono::microseconds max_backoff(
+        MPI_COMPAT_PROGRESS_MAX_BACKOFF_US);
+
+      ProgressEngine &             engine = progress_engine();
+      std::unique_lock<std::mutex> lock(engine.mutex);
+      std::chrono::microseconds    backoff = min_backoff;
+
+      while (!engine.stop)
+        {
+          if (engine.requests.empty() && engine.rings.empty())
+            {
+              engine.wake_up.wait(lock, [&engine]() {
+                return engine.stop || !engine.requests.empty() ||
+                       !engine.rings.empty();
+              });
+              backoff = min_backoff;
+              continue;
+            }
+
+          // Looking for a message drives the progress engine of the MPI
+          // library for all outstanding requests without touching them.
+          // The probe does not receive anything, so it does not matter
+          // whether it matches a message of the application.
+          bool any_completed = false;
+          if (!engine.requests.empty())
+            {
+              int flag;
+              MPI_Iprobe(MPI_ANY_SOURCE,
+                         MPI_ANY_TAG,
+                         MPI_COMM_SELF,
+                         &flag,
+                         MPI_STATUS_IGNORE);
+            }
+
+          // a ring is done once its last messages completed, which the
+          // user then finds in Test() or Wait()
+          for (std::size_t i = 0; i < engine.rings.size();)
+            {
+              int done = 0;
+              advance_allgather_ring(*engine.rings[i], &done);
+              if (done)
+                {
+                  engine.rings[i] = engine.rings.back();
+                  engine.rings.pop_back();
+                  any_completed = true;
+                }
+              else
+                ++i;
+            }
+
+          if (any_completed || engine.new_work)
+            backoff = min_backoff;
+          else
+            backoff = std::min(2 * backoff, max_backoff);
+          engine.new_work = false;
+
+          engine.wake_up.wait_for(lock, backoff, [&engine]() {
+            return engine.stop || engine.new_work;
+          });
+        }
+    }
+
+    /**
+     * Stop the progress thread if it is running.
+     */
+    inline void
+    progress_stop_thread()
+    {
+      ProgressEngine &engine = progress_engine();
+      {
+        std::lock_guard<std::mutex> lock(engine.mutex);
+        if (!engine.running)
+          return;
+        engine.stop = true;
+      }
+      engine.wake_up.notify_all();
+      engine.thread.join();
+
+      std::lock_guard<std::mutex> lock(engine.mutex);
+      engine.running = false;
+      engine.stop    = false;
+      engine.requests.clear();
+      engine.rings.clear();
+    }
+
+    /**
+     * Attribute delete callback on MPI_COMM_SELF, called at the beginning
+     * of MPI_Finalize() or from Progress_stop().
+     */
+    inline int
+    progress_delete_callback(MPI_Comm, int, void *, void *)
+    {
+      progress_stop_thread();
+      return MPI_SUCCESS;
+    }
+#endif
+
+    /**
+     * Hand @p request to the progress thread, if it is running.
+     */
+    inline int
+    progress_register(MPI_Request request)
+    {
+#ifdef MPI_COMPAT_WITH_PROGRESS_THREAD
+      if (request == MPI_REQUEST_NULL)
+        return MPI_SUCCESS;
+
+      ProgressEngine &engine = progress_engine();
+      {
+        std::lock_guard<std::mutex> lock(engine.mutex);
+        if (!engine.running)
+          return MPI_SUCCESS;
+        engine.requests.push_back(request);
+        engine.new_work = true;
+      }
+      engine.wake_up.notify_all();
+#else
+      (void)request;
+#endif
+      return MPI_SUCCESS;
+    }
+
+    /**
+     * Take @p request away from the progress thread before the caller
+     * tests, waits for or frees it.
+     */
+    inline void
+    progress_deregister(MPI_Request request)
+    {
+#ifdef MPI_COMPAT_WITH_PROGRESS_THREAD
+      ProgressEngine &            engine = progress_engine();
+      std::lock_guard<std::mutex> lock(engine.mutex);
+      auto                        it =
+        std::find(engine.requests.begin(), engine.requests.end(), request);
+      if (it != engine.requests.end())
+        engine.requests.erase(it);
+#else
+      (void)request;
+#endif
+    }
+
+    /**
+     * Hand @p ring to the progress thread, if it is running.
+     */
+    inline void
+    progress_register(const std::shared_ptr<AllgatherRing> &ring)
+    {
+#ifdef MPI_COMPAT_WITH_PROGRESS_THREAD
+      ProgressEngine &engine = progress_engine();
+      {
+        std::lock_guard<std::mutex> lock(engine.mutex);
+        if (!engine.running)
+          return;
+        engine.rings.push_back(ring);
+        engine.new_work = true;
+      }
+      engine.wake_up.notify_all();
+#else
+      (void)ring;
+#endif
+    }
+
+    /**
+     * Take @p ring away from the progress thread before the caller
+     * advances or frees it.
+     */
+    inline void
+    progress_deregister(const std::shared_ptr<AllgatherRing> &ring)
+    {
+#ifdef MPI_COMPAT_WITH_PROGRESS_THREAD
+      ProgressEngine &            engine = progress_engine();
+      std::lock_guard<std::mutex> lock(engine.mutex);
+      auto it = std::find(engine.rings.begin(), engine.rings.end(), ring);
+      if (it != engine.rings.end())
+        engine.rings.erase(it);
+#else
+      (void)ring;
+#endif
+    }
+
+    /**
+     * Advance the rings of all outstanding Iallgather_c() operations of
+     * this process except @p ring. Other processes may complete them in a
+     * different order, so waiting for one of them must not hold up the
+     * others.
+     */
+    inline int
+    advance_other_allgather_rings(const std::shared_ptr<AllgatherRing> &ring)
+    {
+      for (auto &entry : request_data())
+        if (entry.second.ring && entry.second.ring != ring)
+          {
+            const std::shared_ptr<AllgatherRing> other = entry.second.ring;
+            progress_deregister(other);
+            int       done;
+            const int ierr = advance_allgather_ring(*other, &done);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+            if (!done)
+              progress_register(other);
+          }
+      return MPI_SUCCESS;
+    }
+  } // namespace internal
+
+#ifdef MPI_COMPAT_WITH_PROGRESS_THREAD
   /**
-   * Write a possibly large @p count of data at the location @p offset.
-   *
-   * See the MPI 4.x standard for details.
+   * Stop the thread started by Progress_start(). Outstanding requests are
+   * not affected and still have to be completed by the caller.
    */
   inline int
-  File_write_at_c(MPI_File     fh,
-                  MPI_Offset   offset,
-                  const void * buf,
-                  MPI_Count    count,
-                  MPI_Datatype datatype,
-                  MPI_Status * status)
+  Progress_stop()
   {
-    if (count <= BigMPICompat::mpi_max_int_count)
-      return MPI_File_write_at(fh, offset, buf, count, datatype, status);
-
-    MPI_Datatype bigtype;
-    int          ierr;
-    ierr = Type_contiguous_c(count, datatype, &bigtype);
-    if (ierr != MPI_SUCCESS)
-      return ierr;
-    ierr = MPI_Type_commit(&bigtype);
-    if (ierr != MPI_SUCCESS)
-      return ierr;
-
-    ierr = MPI_File_write_at(fh, offset, buf, 1, bigtype, status);
-    if (ierr != MPI_SUCCESS)
-      return ierr;
+    internal::ProgressEngine &engine = internal::progress_engine();
+    if (engine.keyval == MPI_KEYVAL_INVALID)
+      return MPI_SUCCESS;
 
-    ierr = MPI_Type_free(&bigtype);
+    // deleting the attribute stops the thread through the callback
+    int ierr = MPI_Comm_delete_attr(MPI_COMM_SELF, engine.keyval);
     if (ierr != MPI_SUCCESS)
       return ierr;
-    return MPI_SUCCESS;
+    return MPI_Comm_free_keyval(&engine.keyval);
   }
 
   /**
-   * Collectively write a possibly large @p count of data at the
-   * location @p offset.
+   * Start a background thread that drives the progress of nonblocking
+   * operations started through BigMPICompat (Isend_c(), Irecv_c(),
+   * Ibcast_c() and Start()) while the application computes. Such requests
+   * should be completed with BigMPICompat::Test() or BigMPICompat::Wait().
+   * The thread never touches the requests themselves, so completing one
+   * with MPI_Test() or MPI_Wait() is safe, but keeps the thread polling
+   * until it is stopped.
    *
-   * See the MPI 4.x standard for details.
+   * The thread is pinned to the core @p cpu if it is not negative (only on
+   * Linux); if that fails, the thread is stopped again and MPI_ERR_OTHER is
+   * returned. It stops automatically at the beginning of MPI_Finalize(), or
+   * earlier with Progress_stop(). MPI has to be initialized with
+   * MPI_THREAD_MULTIPLE, otherwise MPI_ERR_OTHER is returned.
+   *
+   * This is only available if MPI_COMPAT_WITH_PROGRESS_THREAD is defined
+   * before including this file.
    */
   inline int
-  File_write_at_all_c(MPI_File     fh,
-                      MPI_Offset   offset,
-                      const void * buf,
-                      MPI_Count    count,
-                      MPI_Datatype datatype,
-                      MPI_Status * status)
+  Progress_start(int cpu = -1)
   {
-    if (count <= BigMPICompat::mpi_max_int_count)
-      return MPI_File_write_at_all(fh, offset, buf, count, datatype, status);
-
-    MPI_Datatype bigtype;
-    int          ierr;
-    ierr = Type_contiguous_c(count, datatype, &bigtype);
+    int provided;
+    int ierr = MPI_Query_thread(&provided);
     if (ierr != MPI_SUCCESS)
       return ierr;
-    ierr = MPI_Type_commit(&bigtype);
+    if (provided != MPI_THREAD_MULTIPLE)
+      return MPI_ERR_OTHER;
+
+    internal::ProgressEngine &engine = internal::progress_engine();
+    if (engine.keyval != MPI_KEYVAL_INVALID)
+      return MPI_SUCCESS;
+
+    // The attribute is set before the thread starts, so that every error
+    // below can be rolled back by Progress_stop().
+    ierr = MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN,
+                                  &internal::progress_delete_callback,
+                                  &engine.keyval,
+                                  nullptr);
+    if (ierr != MPI_SUCCESS)
+      {
+        engine.keyval = MPI_KEYVAL_INVALID;
+        return ierr;
+      }
+    ierr = MPI_Comm_set_attr(MPI_COMM_SELF, engine.keyval, nullptr);
+    if (ierr != MPI_SUCCESS)
+      {
+        MPI_Comm_free_keyval(&engine.keyval);
+        return ierr;
+      }
+
+    {
+      std::lock_guard<std::mutex> lock(engine.mutex);
+      engine.thread  = std::thread(&internal::progress_loop);
+      engine.running = true;
+    }
+
+#  ifdef __linux__
+    if (cpu >= 0)
+      {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+        if (pthread_setaffinity_np(
+              engine.thread.native_handle(), sizeof(cpuset), &cpuset) != 0)
+          {
+            Progress_stop();
+            return MPI_ERR_OTHER;
+          }
+      }
+#  else
+    (void)cpu;
+#  endif
+
+    return MPI_SUCCESS;
+  }
+#endif
+
+  /**
+   * Start sending a (possibly large) @p count to rank @p dest without
+   * blocking.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Isend_c(const void * buf,
+          MPI_Count    count,
+          MPI_Datatype datatype,
+          int          dest,
+          int          tag,
+          MPI_Comm     comm,
+          MPI_Request *request)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Isend_c");
+    int ierr;
+#if MPI_VERSION >= 4
+    ierr = MPI_Isend_c(buf, count, datatype, dest, tag, comm, request);
+#else
+    if (count <= BigMPICompat::mpi_max_int_count)
+      ierr = MPI_Isend(buf, count, datatype, dest, tag, comm, request);
+    else
+      {
+        MPI_Datatype bigtype;
+        ierr = Type_contiguous_c(count, datatype, &bigtype);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        ierr = MPI_Isend(buf, 1, bigtype, dest, tag, comm, request);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        // The pending operation completes normally after freeing the type.
+        ierr = MPI_Type_free(&bigtype);
+      }
+#endif
     if (ierr != MPI_SUCCESS)
       return ierr;
+    return internal::progress_register(*request);
+  }
 
-    ierr = MPI_File_write_at_all(fh, offset, buf, 1, bigtype, status);
+  /**
+   * Start receiving a (possibly large) @p count from rank @p source
+   * without blocking.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Irecv_c(void *       buf,
+          MPI_Count    count,
+          MPI_Datatype datatype,
+          int          source,
+          int          tag,
+          MPI_Comm     comm,
+          MPI_Request *request)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Irecv_c");
+    int ierr;
+#if MPI_VERSION >= 4
+    ierr = MPI_Irecv_c(buf, count, datatype, source, tag, comm, request);
+#else
+    if (count <= BigMPICompat::mpi_max_int_count)
+      ierr = MPI_Irecv(buf, count, datatype, source, tag, comm, request);
+    else
+      {
+        MPI_Datatype bigtype;
+        ierr = Type_contiguous_c(count, datatype, &bigtype);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        ierr = MPI_Irecv(buf, 1, bigtype, source, tag, comm, request);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        ierr = MPI_Type_free(&bigtype);
+      }
+#endif
     if (ierr != MPI_SUCCESS)
       return ierr;
+    return internal::progress_register(*request);
+  }
 
-    ierr = MPI_Type_free(&bigtype);
+  /**
+   * Start broadcasting a (possibly large) @p count from rank @p root to
+   * all processes in @p comm without blocking.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Ibcast_c(void *       buf,
+           MPI_Count    count,
+           MPI_Datatype datatype,
+           int          root,
+           MPI_Comm     comm,
+           MPI_Request *request)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Ibcast_c");
+    int ierr;
+#if MPI_VERSION >= 4
+    ierr = MPI_Ibcast_c(buf, count, datatype, root, comm, request);
+#else
+    if (count <= BigMPICompat::mpi_max_int_count)
+      ierr = MPI_Ibcast(buf, count, datatype, root, comm, request);
+    else
+      {
+        MPI_Datatype bigtype;
+        ierr = Type_contiguous_c(count, datatype, &bigtype);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        ierr = MPI_Ibcast(buf, 1, bigtype, root, comm, request);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        ierr = MPI_Type_free(&bigtype);
+      }
+#endif
     if (ierr != MPI_SUCCESS)
       return ierr;
-    return MPI_SUCCESS;
+    return internal::progress_register(*request);
   }
 
   /**
-   * Collectively write a possibly large @p count of data in order.
+   * Create a persistent request to send a (possibly large) @p count to
+   * rank @p dest. The large datatype is constructed only once here and
+   * kept until the request is freed with Request_free().
    *
    * See the MPI 4.x standard for details.
    */
   inline int
-  File_write_ordered_c(MPI_File     fh,
-                       const void * buf,
-                       MPI_Count    count,
-                       MPI_Datatype datatype,
-                       MPI_Status * status)
+  Send_init_c(const void * buf,
+              MPI_Count    count,
+              MPI_Datatype datatype,
+              int          dest,
+              int          tag,
+              MPI_Comm     comm,
+              MPI_Request *request)
   {
+    MPI_COMPAT_TRACE_SCOPE("Send_init_c");
+#if MPI_VERSION >= 4
+    return MPI_Send_init_c(buf, count, datatype, dest, tag, comm, request);
+#else
     if (count <= BigMPICompat::mpi_max_int_count)
-      return MPI_File_write_ordered(fh, buf, count, datatype, status);
+      return MPI_Send_init(buf, count, datatype, dest, tag, comm, request);
 
     MPI_Datatype bigtype;
     int          ierr;
     ierr = Type_contiguous_c(count, datatype, &bigtype);
     if (ierr != MPI_SUCCESS)
       return ierr;
-    ierr = MPI_Type_commit(&bigtype);
+
+    ierr = MPI_Send_init(buf, 1, bigtype, dest, tag, comm, request);
     if (ierr != MPI_SUCCESS)
       return ierr;
 
-    ierr = MPI_File_write_ordered(fh, buf, 1, bigtype, status);
+    internal::request_data()[*request].bigtype = bigtype;
+    return MPI_SUCCESS;
+#endif
+  }
+
+  /**
+   * Create a persistent request to receive a (possibly large) @p count
+   * from rank @p source. The large datatype is constructed only once here
+   * and kept until the request is freed with Request_free().
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Recv_init_c(void *       buf,
+              MPI_Count    count,
+              MPI_Datatype datatype,
+              int          source,
+              int          tag,
+              MPI_Comm     comm,
+              MPI_Request *request)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Recv_init_c");
+#if MPI_VERSION >= 4
+    return MPI_Recv_init_c(buf, count, datatype, source, tag, comm, request);
+#else
+    if (count <= BigMPICompat::mpi_max_int_count)
+      return MPI_Recv_init(buf, count, datatype, source, tag, comm, request);
+
+    MPI_Datatype bigtype;
+    int          ierr;
+    ierr = Type_contiguous_c(count, datatype, &bigtype);
     if (ierr != MPI_SUCCESS)
       return ierr;
 
-    ierr = MPI_Type_free(&bigtype);
+    ierr = MPI_Recv_init(buf, 1, bigtype, source, tag, comm, request);
     if (ierr != MPI_SUCCESS)
       return ierr;
+
+    internal::request_data()[*request].bigtype = bigtype;
     return MPI_SUCCESS;
+#endif
   }
 
   /**
-   * Read a possibly large @p count of data at the
-   * location @p offset.
+   * Create a persistent request to broadcast a (possibly large) @p count
+   * from rank @p root to all processes in @p comm.
+   *
+   * MPI 3.x has no persistent collectives. In that case the request
+   * returned is a placeholder and the broadcast is started as MPI_Ibcast()
+   * with the datatype created here, so the request must be used with
+   * Start(), Test(), Wait() and Request_free() from this namespace instead
+   * of the MPI functions.
    *
    * See the MPI 4.x standard for details.
    */
   inline int
-  File_read_at_c(MPI_File     fh,
-                 MPI_Offset   offset,
-                 void *       buf,
-                 MPI_Count    count,
-                 MPI_Datatype datatype,
-                 MPI_Status * status)
+  Bcast_init_c(void *       buf,
+               MPI_Count    count,
+               MPI_Datatype datatype,
+               int          root,
+               MPI_Comm     comm,
+               MPI_Info     info,
+               MPI_Request *request)
   {
-    if (count <= BigMPICompat::mpi_max_int_count)
-      return MPI_File_read_at(fh, offset, buf, count, datatype, status);
+    MPI_COMPAT_TRACE_SCOPE("Bcast_init_c");
+#if MPI_VERSION >= 4
+    return MPI_Bcast_init_c(buf, count, datatype, root, comm, info, request);
+#else
+    (void)info;
 
-    MPI_Datatype bigtype;
+    MPI_Datatype bigtype = MPI_DATATYPE_NULL;
     int          ierr;
-    ierr = Type_contiguous_c(count, datatype, &bigtype);
+    if (count > BigMPICompat::mpi_max_int_count)
+      {
+        ierr = Type_contiguous_c(count, datatype, &bigtype);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+
+    // An inactive persistent request that does nothing when started serves
+    // as a unique handle for the broadcast.
+    ierr = MPI_Recv_init(
+      nullptr, 0, MPI_BYTE, MPI_PROC_NULL, 0, MPI_COMM_SELF, request);
     if (ierr != MPI_SUCCESS)
       return ierr;
-    ierr = MPI_Type_commit(&bigtype);
+
+    internal::RequestData &data = internal::request_data()[*request];
+
+    data.bigtype  = bigtype;
+    data.is_bcast = true;
+    data.buf      = buf;
+    data.count    = (bigtype == MPI_DATATYPE_NULL) ? count : 1;
+    data.datatype = (bigtype == MPI_DATATYPE_NULL) ? datatype : bigtype;
+    data.root     = root;
+    data.comm     = comm;
+    return MPI_SUCCESS;
+#endif
+  }
+
+  /**
+   * Start the persistent request @p request created by one of the
+   * *_init_c() functions.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Start(MPI_Request *request)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Start");
+    auto it = internal::request_data().find(*request);
+    if (it != internal::request_data().end() &&
+        !it->second.partitions.empty())
+      {
+        if (!it->second.is_precv)
+          {
+            it->second.n_started->store(0);
+            return MPI_SUCCESS;
+          }
+        for (MPI_Request &partition : it->second.partitions)
+          {
+            const int ierr = Start(&partition);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+        return MPI_SUCCESS;
+      }
+
+    if (it != internal::request_data().end() && it->second.is_bcast)
+      {
+        internal::RequestData &data = it->second;
+        const int              ierr = MPI_Ibcast(data.buf,
+                                    data.count,
+                                    data.datatype,
+                                    data.root,
+                                    data.comm,
+                                    &data.active);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+        return internal::progress_register(data.active);
+      }
+
+    const int ierr = MPI_Start(request);
     if (ierr != MPI_SUCCESS)
       return ierr;
+    return internal::progress_register(*request);
+  }
 
-    ierr = MPI_File_read_at(fh, offset, buf, 1, bigtype, status);
+  /**
+   * Test whether the request @p request has completed.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Test(MPI_Request *request, int *flag, MPI_Status *status)
+  {
+    auto it = internal::request_data().find(*request);
+    if (it != internal::request_data().end() && it->second.ring)
+      {
+        const std::shared_ptr<internal::AllgatherRing> ring = it->second.ring;
+        int ierr = internal::advance_other_allgather_rings(ring);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+        internal::progress_deregister(ring);
+        ierr = internal::advance_allgather_ring(*ring, flag);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+        if (!*flag)
+          {
+            internal::progress_register(ring);
+            return MPI_SUCCESS;
+          }
+        internal::request_data().erase(it);
+        return MPI_Request_free(request);
+      }
+    if (it != internal::request_data().end() &&
+        !it->second.partitions.empty())
+      {
+        *flag = 0;
+        if (it->second.n_started->load() <
+            static_cast<int>(it->second.partitions.size()))
+          return MPI_SUCCESS;
+
+        *flag = 1;
+        for (MPI_Request &partition : it->second.partitions)
+          {
+            int       partition_flag;
+            const int ierr =
+              Test(&partition, &partition_flag, MPI_STATUS_IGNORE);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+            if (!partition_flag)
+              *flag = 0;
+          }
+        return MPI_SUCCESS;
+      }
+
+    MPI_Request *active =
+      (it != internal::request_data().end() && it->second.is_bcast) ?
+        &it->second.active :
+        request;
+
+    // The progress thread must not poll the request while we test it. If
+    // it is not complete yet, hand it back afterwards.
+    const MPI_Request handle = *active;
+    internal::progress_deregister(handle);
+    const int ierr = MPI_Test(active, flag, status);
     if (ierr != MPI_SUCCESS)
       return ierr;
+    if (!*flag)
+      return internal::progress_register(handle);
 
-    ierr = MPI_Type_free(&bigtype);
+    if (it != internal::request_data().end() &&
+        it->second.release_on_completion)
+      internal::request_data().erase(it);
+    return MPI_SUCCESS;
+  }
+
+  /**
+   * Wait for the request @p request to complete. Persistent requests
+   * stay allocated and can be started again.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Wait(MPI_Request *request, MPI_Status *status)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Wait");
+    auto it = internal::request_data().find(*request);
+    if (it != internal::request_data().end() && it->second.ring)
+      {
+        // poll instead of blocking in MPI_Wait(), so that the rings of
+        // the other outstanding operations advance in the meantime
+        const std::shared_ptr<internal::AllgatherRing> ring = it->second.ring;
+        internal::progress_deregister(ring);
+        int done = 0;
+        while (!done)
+          {
+            int ierr = internal::advance_allgather_ring(*ring, &done);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+            if (!done)
+              {
+                ierr = internal::advance_other_allgather_rings(ring);
+                if (ierr != MPI_SUCCESS)
+                  return ierr;
+              }
+          }
+        internal::request_data().erase(it);
+        return MPI_Request_free(request);
+      }
+    if (it != internal::request_data().end() &&
+        !it->second.partitions.empty())
+      {
+        // the partitions of a send may still be marked ready by other
+        // threads, and are only sent from then on
+        while (it->second.n_started->load() <
+               static_cast<int>(it->second.partitions.size()))
+          std::this_thread::yield();
+
+        for (MPI_Request &partition : it->second.partitions)
+          {
+            const int ierr = Wait(&partition, MPI_STATUS_IGNORE);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+        return MPI_SUCCESS;
+      }
+
+    MPI_Request *active =
+      (it != internal::request_data().end() && it->second.is_bcast) ?
+        &it->second.active :
+        request;
+
+    internal::progress_deregister(*active);
+    const int ierr = MPI_Wait(active, status);
     if (ierr != MPI_SUCCESS)
       return ierr;
+
+    if (it != internal::request_data().end() &&
+        it->second.release_on_completion)
+      internal::request_data().erase(it);
     return MPI_SUCCESS;
   }
 
   /**
-   * Collectively read a possibly large @p count of data at the
-   * location @p offset.
+   * Free the request @p request together with all data BigMPICompat
+   * allocated for it.
    *
    * See the MPI 4.x standard for details.
    */
   inline int
-  File_read_at_all_c(MPI_File     fh,
-                     MPI_Offset   offset,
-                     void *       buf,
-                     MPI_Count    count,
-                     MPI_Datatype datatype,
-                     MPI_Status * status)
+  Request_free(MPI_Request *request)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Request_free");
+    int  ierr;
+    auto it = internal::request_data().find(*request);
+    if (it != internal::request_data().end())
+      {
+        internal::RequestData &data = it->second;
+        if (data.active != MPI_REQUEST_NULL)
+          {
+            internal::progress_deregister(data.active);
+            ierr = MPI_Request_free(&data.active);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+        for (MPI_Request &partition : data.partitions)
+          {
+            ierr = Request_free(&partition);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+        if (data.ring)
+          {
+            internal::progress_deregister(data.ring);
+            for (std::vector<MPI_Request> *requests :
+                 {&data.ring->receives, &data.ring->sends})
+              for (MPI_Request &part : *requests)
+                if (part != MPI_REQUEST_NULL)
+                  {
+                    ierr = MPI_Request_free(&part);
+                    if (ierr != MPI_SUCCESS)
+                      return ierr;
+                  }
+          }
+        if (data.bigtype != MPI_DATATYPE_NULL)
+          {
+            ierr = MPI_Type_free(&data.bigtype);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+        internal::request_data().erase(it);
+      }
+
+    internal::progress_deregister(*request);
+    return MPI_Request_free(request);
+  }
+
+  /**
+   * Write a possibly large @p count of data at the location @p offset.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  File_write_at_c(MPI_File     fh,
+                  MPI_Offset   offset,
+                  const void * buf,
+                  MPI_Count    count,
+                  MPI_Datatype datatype,
+                  MPI_Status * status)
   {
+    MPI_COMPAT_TRACE_SCOPE("File_write_at_c");
     if (count <= BigMPICompat::mpi_max_int_count)
-      return MPI_File_read_at_all(fh, offset, buf, count, datatype, status);
+      return MPI_File_write_at(fh, offset, buf, count, datatype, status);
 
     MPI_Datatype bigtype;
     int          ierr;
     ierr = Type_contiguous_c(count, datatype, &bigtype);
-    if (ierr != MPI_SUCCESS)
-      return ierr;
-    ierr = MPI_Type_commit(&bigtype);
     if (ierr != MPI_SUCCESS)
       return ierr;
 
-    ierr = MPI_File_read_at_all(fh, offset, buf, 1, bigtype, status);
+    ierr = MPI_File_write_at(fh, offset, buf, 1, bigtype, status);
     if (ierr != MPI_SUCCESS)
       return ierr;
 
@@ -414,6 +1820,4684 @@ namespace BigMPICompat
     return MPI_SUCCESS;
   }
 
+  /**
+   * Collectively write a possibly large @p count of data at the
+   * location @p offset.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  File_write_at_all_c(MPI_File     fh,
+                      MPI_Offset   offset,
+                      const void * buf,
+                      MPI_Count    count,
+                      MPI_Datatype datatype,
+                      MPI_Status * status)
+  {
+    MPI_COMPAT_TRACE_SCOPE("File_write_at_all_c");
+    if (count <= BigMPICompat::mpi_max_int_count)
+      return MPI_File_write_at_all(fh, offset, buf, count, datatype, status);
+
+    MPI_Datatype bigtype;
+    int          ierr;
+    ierr = Type_contiguous_c(count, datatype, &bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = MPI_File_write_at_all(fh, offset, buf, 1, bigtype, status);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = MPI_Type_free(&bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    return MPI_SUCCESS;
+  }
+
+  /**
+   * Collectively write a possibly large @p count of data in order.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  File_write_ordered_c(MPI_File     fh,
+                       const void * buf,
+                       MPI_Count    count,
+                       MPI_Datatype datatype,
+                       MPI_Status * status)
+  {
+    MPI_COMPAT_TRACE_SCOPE("File_write_ordered_c");
+    if (count <= BigMPICompat::mpi_max_int_count)
+      return MPI_File_write_ordered(fh, buf, count, datatype, status);
+
+    MPI_Datatype bigtype;
+    int          ierr;
+    ierr = Type_contiguous_c(count, datatype, &bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = MPI_File_write_ordered(fh, buf, 1, bigtype, status);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = MPI_Type_free(&bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    return MPI_SUCCESS;
+  }
+
+  /**
+   * Read a possibly large @p count of data at the
+   * location @p offset.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  File_read_at_c(MPI_File     fh,
+                 MPI_Offset   offset,
+                 void *       buf,
+                 MPI_Count    count,
+                 MPI_Datatype datatype,
+                 MPI_Status * status)
+  {
+    MPI_COMPAT_TRACE_SCOPE("File_read_at_c");
+    if (count <= BigMPICompat::mpi_max_int_count)
+      return MPI_File_read_at(fh, offset, buf, count, datatype, status);
+
+    MPI_Datatype bigtype;
+    int          ierr;
+    ierr = Type_contiguous_c(count, datatype, &bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = MPI_File_read_at(fh, offset, buf, 1, bigtype, status);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = MPI_Type_free(&bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    return MPI_SUCCESS;
+  }
+
+  /**
+   * Collectively read a possibly large @p count of data at the
+   * location @p offset.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  File_read_at_all_c(MPI_File     fh,
+                     MPI_Offset   offset,
+                     void *       buf,
+                     MPI_Count    count,
+                     MPI_Datatype datatype,
+                     MPI_Status * status)
+  {
+    MPI_COMPAT_TRACE_SCOPE("File_read_at_all_c");
+    if (count <= BigMPICompat::mpi_max_int_count)
+      return MPI_File_read_at_all(fh, offset, buf, count, datatype, status);
+
+    MPI_Datatype bigtype;
+    int          ierr;
+    ierr = Type_contiguous_c(count, datatype, &bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = MPI_File_read_at_all(fh, offset, buf, 1, bigtype, status);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = MPI_Type_free(&bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    return MPI_SUCCESS;
+  }
+
+  /**
+   * Create a window for one-sided communication that exposes a
+   * (possibly large) @p size bytes starting at @p base.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Win_create_c(void *   base,
+               MPI_Aint size,
+               MPI_Aint disp_unit,
+               MPI_Info info,
+               MPI_Comm comm,
+               MPI_Win *win)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Win_create_c");
+#if MPI_VERSION >= 4
+    return MPI_Win_create_c(base, size, disp_unit, info, comm, win);
+#else
+    // The size of the window is already an MPI_Aint in MPI 3.x, only the
+    // displacement unit is limited to int, independent of
+    // MPI_COMPAT_MAX_INT_COUNT.
+    if (disp_unit > std::numeric_limits<int>::max())
+      return MPI_ERR_DISP;
+
+    return MPI_Win_create(base, size, disp_unit, info, comm, win);
+#endif
+  }
+
+  /**
+   * Allocate memory of (possibly large) @p size bytes and create a window
+   * for one-sided communication exposing it. The address of the allocated
+   * memory is returned in @p baseptr.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Win_allocate_c(MPI_Aint size,
+                 MPI_Aint disp_unit,
+                 MPI_Info info,
+                 MPI_Comm comm,
+                 void *   baseptr,
+                 MPI_Win *win)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Win_allocate_c");
+#if MPI_VERSION >= 4
+    return MPI_Win_allocate_c(size, disp_unit, info, comm, baseptr, win);
+#else
+    if (disp_unit > std::numeric_limits<int>::max())
+      return MPI_ERR_DISP;
+
+    return MPI_Win_allocate(size, disp_unit, info, comm, baseptr, win);
+#endif
+  }
+
+  /**
+   * Allocate shared memory of (possibly large) @p size bytes on each
+   * process of @p comm, which must only contain processes that can share
+   * memory, and create a window exposing it.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Win_allocate_shared_c(MPI_Aint size,
+                        MPI_Aint disp_unit,
+                        MPI_Info info,
+                        MPI_Comm comm,
+                        void *   baseptr,
+                        MPI_Win *win)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Win_allocate_shared_c");
+#if MPI_VERSION >= 4
+    return MPI_Win_allocate_shared_c(size, disp_unit, info, comm, baseptr, win);
+#else
+    if (disp_unit > std::numeric_limits<int>::max())
+      return MPI_ERR_DISP;
+
+    return MPI_Win_allocate_shared(size, disp_unit, info, comm, baseptr, win);
+#endif
+  }
+
+  /**
+   * Put a (possibly large) @p origin_count of data into the window @p win
+   * of process @p target_rank.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Put_c(const void * origin_addr,
+        MPI_Count    origin_count,
+        MPI_Datatype origin_datatype,
+        int          target_rank,
+        MPI_Aint     target_disp,
+        MPI_Count    target_count,
+        MPI_Datatype target_datatype,
+        MPI_Win      win)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Put_c");
+#if MPI_VERSION >= 4
+    return MPI_Put_c(origin_addr,
+                     origin_count,
+                     origin_datatype,
+                     target_rank,
+                     target_disp,
+                     target_count,
+                     target_datatype,
+                     win);
+#else
+    if (origin_count <= BigMPICompat::mpi_max_int_count &&
+        target_count <= BigMPICompat::mpi_max_int_count)
+      return MPI_Put(origin_addr,
+                     origin_count,
+                     origin_datatype,
+                     target_rank,
+                     target_disp,
+                     target_count,
+                     target_datatype,
+                     win);
+
+    MPI_Datatype origin_bigtype;
+    MPI_Datatype target_bigtype;
+    int          ierr;
+    ierr = Type_contiguous_c(origin_count, origin_datatype, &origin_bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = Type_contiguous_c(target_count, target_datatype, &target_bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = MPI_Put(origin_addr,
+                   1,
+                   origin_bigtype,
+                   target_rank,
+                   target_disp,
+                   1,
+                   target_bigtype,
+                   win);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    // The types may be freed right away, the pending operation will
+    // complete normally.
+    ierr = MPI_Type_free(&origin_bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = MPI_Type_free(&target_bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    return MPI_SUCCESS;
+#endif
+  }
+
+  /**
+   * Get a (possibly large) @p target_count of data from the window @p win
+   * of process @p target_rank.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Get_c(void *       origin_addr,
+        MPI_Count    origin_count,
+        MPI_Datatype origin_datatype,
+        int          target_rank,
+        MPI_Aint     target_disp,
+        MPI_Count    target_count,
+        MPI_Datatype target_datatype,
+        MPI_Win      win)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Get_c");
+#if MPI_VERSION >= 4
+    return MPI_Get_c(origin_addr,
+                     origin_count,
+                     origin_datatype,
+                     target_rank,
+                     target_disp,
+                     target_count,
+                     target_datatype,
+                     win);
+#else
+    if (origin_count <= BigMPICompat::mpi_max_int_count &&
+        target_count <= BigMPICompat::mpi_max_int_count)
+      return MPI_Get(origin_addr,
+                     origin_count,
+                     origin_datatype,
+                     target_rank,
+                     target_disp,
+                     target_count,
+                     target_datatype,
+                     win);
+
+    MPI_Datatype origin_bigtype;
+    MPI_Datatype target_bigtype;
+    int          ierr;
+    ierr = Type_contiguous_c(origin_count, origin_datatype, &origin_bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = Type_contiguous_c(target_count, target_datatype, &target_bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = MPI_Get(origin_addr,
+                   1,
+                   origin_bigtype,
+                   target_rank,
+                   target_disp,
+                   1,
+                   target_bigtype,
+                   win);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = MPI_Type_free(&origin_bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = MPI_Type_free(&target_bigtype);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    return MPI_SUCCESS;
+#endif
+  }
+
+  /**
+   * Accumulate a (possibly large) @p origin_count of data into the window
+   * @p win of process @p target_rank using the operation @p op.
+   *
+   * Without native support, the operation is split into pieces of at most
+   * mpi_max_int_count elements, so that the origin side always uses the
+   * (predefined) @p origin_datatype as required by many implementations for
+   * the builtin operations. Accumulate operations are only atomic per
+   * element, so this does not change the semantics. The fallback requires
+   * @p origin_count and @p target_count to be equal.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Accumulate_c(const void * origin_addr,
+               MPI_Count    origin_count,
+               MPI_Datatype origin_datatype,
+               int          target_rank,
+               MPI_Aint     target_disp,
+               MPI_Count    target_count,
+               MPI_Datatype target_datatype,
+               MPI_Op       op,
+               MPI_Win      win)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Accumulate_c");
+#if MPI_VERSION >= 4
+    return MPI_Accumulate_c(origin_addr,
+                            origin_count,
+                            origin_datatype,
+                            target_rank,
+                            target_disp,
+                            target_count,
+                            target_datatype,
+                            op,
+                            win);
+#else
+    if (origin_count <= BigMPICompat::mpi_max_int_count &&
+        target_count <= BigMPICompat::mpi_max_int_count)
+      return MPI_Accumulate(origin_addr,
+                            origin_count,
+                            origin_datatype,
+                            target_rank,
+                            target_disp,
+                            target_count,
+                            target_datatype,
+                            op,
+                            win);
+
+    if (origin_count != target_count)
+      return MPI_ERR_COUNT;
+
+    int      ierr;
+    MPI_Aint lb, origin_extent, target_extent;
+    ierr = MPI_Type_get_extent(origin_datatype, &lb, &origin_extent);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = MPI_Type_get_extent(target_datatype, &lb, &target_extent);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    for (MPI_Count offset = 0; offset < origin_count;
+         offset += BigMPICompat::mpi_max_int_count)
+      {
+        MPI_COMPAT_TRACE_SCOPE("chunk");
+        const int chunk = static_cast<int>(
+          std::min(origin_count - offset, BigMPICompat::mpi_max_int_count));
+
+        // The displacement of this piece inside the target window is
+        // expressed in bytes, because we do not know the displacement
+        // unit the target process used to create the window.
+        const MPI_Aint byte_displacement = offset * target_extent;
+        MPI_Datatype   chunk_type;
+        ierr = MPI_Type_create_hindexed_block(
+          1, chunk, &byte_displacement, target_datatype, &chunk_type);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+        ierr = MPI_Type_commit(&chunk_type);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        ierr = MPI_Accumulate(static_cast<const char *>(origin_addr) +
+                                offset * origin_extent,
+                              chunk,
+                              origin_datatype,
+                              target_rank,
+                              target_disp,
+                              1,
+                              chunk_type,
+                              op,
+                              win);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        ierr = MPI_Type_free(&chunk_type);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+    return MPI_SUCCESS;
+#endif
+  }
+
+  /**
+   * Accumulate a (possibly large) @p origin_count of data into the window
+   * @p win of process @p target_rank using the operation @p op and return
+   * the previous content of the target in @p result_addr.
+   *
+   * The fallback splits the operation into pieces like Accumulate_c() and
+   * requires @p result_count and @p target_count (and @p origin_count,
+   * unless @p op is MPI_NO_OP) to be equal.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Get_accumulate_c(const void * origin_addr,
+                   MPI_Count    origin_count,
+                   MPI_Datatype origin_datatype,
+                   void *       result_addr,
+                   MPI_Count    result_count,
+                   MPI_Datatype result_datatype,
+                   int          target_rank,
+                   MPI_Aint     target_disp,
+                   MPI_Count    target_count,
+                   MPI_Datatype target_datatype,
+                   MPI_Op       op,
+                   MPI_Win      win)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Get_accumulate_c");
+#if MPI_VERSION >= 4
+    return MPI_Get_accumulate_c(origin_addr,
+                                origin_count,
+                                origin_datatype,
+                                result_addr,
+                                result_count,
+                                result_datatype,
+                                target_rank,
+                                target_disp,
+                                target_count,
+                                target_datatype,
+                                op,
+                                win);
+#else
+    if (origin_count <= BigMPICompat::mpi_max_int_count &&
+        result_count <= BigMPICompat::mpi_max_int_count &&
+        target_count <= BigMPICompat::mpi_max_int_count)
+      return MPI_Get_accumulate(origin_addr,
+                                origin_count,
+                                origin_datatype,
+                                result_addr,
+                                result_count,
+                                result_datatype,
+                                target_rank,
+                                target_disp,
+                                target_count,
+                                target_datatype,
+                                op,
+                                win);
+
+    if (result_count != target_count ||
+        (op != MPI_NO_OP && origin_count != target_count))
+      return MPI_ERR_COUNT;
+
+    int      ierr;
+    MPI_Aint lb, origin_extent, result_extent, target_extent;
+    ierr = MPI_Type_get_extent(origin_datatype, &lb, &origin_extent);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = MPI_Type_get_extent(result_datatype, &lb, &result_extent);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = MPI_Type_get_extent(target_datatype, &lb, &target_extent);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    for (MPI_Count offset = 0; offset < target_count;
+         offset += BigMPICompat::mpi_max_int_count)
+      {
+        MPI_COMPAT_TRACE_SCOPE("chunk");
+        const int chunk = static_cast<int>(
+          std::min(target_count - offset, BigMPICompat::mpi_max_int_count));
+
+        const MPI_Aint byte_displacement = offset * target_extent;
+        MPI_Datatype   chunk_type;
+        ierr = MPI_Type_create_hindexed_block(
+          1, chunk, &byte_displacement, target_datatype, &chunk_type);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+        ierr = MPI_Type_commit(&chunk_type);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        // With MPI_NO_OP the origin buffer is ignored and may be empty.
+        const bool has_origin = (origin_count > 0);
+        ierr                  = MPI_Get_accumulate(
+          has_origin ? static_cast<const char *>(origin_addr) +
+                         offset * origin_extent :
+                       origin_addr,
+          has_origin ? chunk : 0,
+          origin_datatype,
+          static_cast<char *>(result_addr) + offset * result_extent,
+          chunk,
+          result_datatype,
+          target_rank,
+          target_disp,
+          1,
+          chunk_type,
+          op,
+          win);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        ierr = MPI_Type_free(&chunk_type);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+    return MPI_SUCCESS;
+#endif
+  }
+
+  namespace internal
+  {
+    /**
+     * Lookup tables for the software implementation of CRC32C
+     * (Castagnoli polynomial) using slicing-by-8.
+     */
+    struct Crc32cTable
+    {
+      std::uint32_t table[8][256];
+
+      Crc32cTable()
+      {
+        for (std::uint32_t i = 0; i < 256; ++i)
+          {
+            std::uint32_t crc = i;
+            for (unsigned int bit = 0; bit < 8; ++bit)
+              crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+            table[0][i] = crc;
+          }
+        for (std::uint32_t i = 0; i < 256; ++i)
+          for (unsigned int k = 1; k < 8; ++k)
+            table[k][i] =
+              (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+      }
+    };
+
+    /**
+     * Update the (inverted) CRC32C @p crc with @p n_bytes at @p data in
+     * software.
+     */
+    inline std::uint32_t
+    crc32c_software(std::uint32_t crc, const void *data, std::size_t n_bytes)
+    {
+      static const Crc32cTable table;
+      const unsigned char *    p = static_cast<const unsigned char *>(data);
+
+      for (; n_bytes >= 8; n_bytes -= 8, p += 8)
+        {
+          std::uint32_t low, high;
+          std::memcpy(&low, p, 4);
+          std::memcpy(&high, p + 4, 4);
+          // the tables assume little endian byte order
+          low ^= crc;
+          crc = table.table[7][low & 0xff] ^
+                table.table[6][(low >> 8) & 0xff] ^
+                table.table[5][(low >> 16) & 0xff] ^
+                table.table[4][low >> 24] ^ table.table[3][high & 0xff] ^
+                table.table[2][(high >> 8) & 0xff] ^
+                table.table[1][(high >> 16) & 0xff] ^
+                table.table[0][high >> 24];
+        }
+      for (; n_bytes > 0; --n_bytes, ++p)
+        crc = (crc >> 8) ^ table.table[0][(crc ^ *p) & 0xff];
+      return crc;
+    }
+
+#ifdef MPI_COMPAT_HAVE_SSE42_CRC32C
+    /**
+     * Update the (inverted) CRC32C @p crc with @p n_bytes at @p data using
+     * the SSE 4.2 crc32 instruction. Only call this if the CPU supports it.
+     */
+    __attribute__((target("sse4.2"))) inline std::uint32_t
+    crc32c_sse42(std::uint32_t crc, const void *data, std::size_t n_bytes)
+    {
+      const unsigned char *p     = static_cast<const unsigned char *>(data);
+      std::uint64_t        crc64 = crc;
+
+      for (; n_bytes >= 8; n_bytes -= 8, p += 8)
+        {
+          std::uint64_t value;
+          std::memcpy(&value, p, 8);
+          crc64 = _mm_crc32_u64(crc64, value);
+        }
+      crc = static_cast<std::uint32_t>(crc64);
+      for (; n_bytes > 0; --n_bytes, ++p)
+        crc = _mm_crc32_u8(crc, *p);
+      return crc;
+    }
+#endif
+  } // namespace internal
+
+  /**
+   * Compute the CRC32C checksum of @p n_bytes at @p data. Passing the
+   * result of a previous call as @p crc continues the checksum, so that
+   * Crc32c(b, nb, Crc32c(a, na)) is the checksum of a followed by b.
+   *
+   * The crc32 instruction of SSE 4.2 is used if the CPU supports it.
+   */
+  inline std::uint32_t
+  Crc32c(const void *data, std::size_t n_bytes, std::uint32_t crc = 0)
+  {
+#ifdef MPI_COMPAT_HAVE_SSE42_CRC32C
+    static const bool have_sse42 = __builtin_cpu_supports("sse4.2");
+    if (have_sse42)
+      return ~internal::crc32c_sse42(~crc, data, n_bytes);
+#endif
+    return ~internal::crc32c_software(~crc, data, n_bytes);
+  }
+
+  /**
+   * The transfers with checksums below split the data into chunks of this
+   * many bytes and compute one CRC32C per chunk.
+   */
+  static constexpr MPI_Count checksum_chunk_bytes =
+    (BigMPICompat::mpi_max_int_count < (1 << 26)) ?
+      BigMPICompat::mpi_max_int_count :
+      (1 << 26);
+
+  namespace internal
+  {
+    /**
+     * Return the number of checksum chunks for @p n_bytes.
+     */
+    inline MPI_Count
+    n_checksum_chunks(MPI_Count n_bytes)
+    {
+      return (n_bytes + checksum_chunk_bytes - 1) / checksum_chunk_bytes;
+    }
+
+    /**
+     * Return the size of the checksum chunk @p chunk of @p n_bytes.
+     */
+    inline int
+    checksum_chunk_size(MPI_Count n_bytes, MPI_Count chunk)
+    {
+      return static_cast<int>(
+        std::min(checksum_chunk_bytes, n_bytes - chunk * checksum_chunk_bytes));
+    }
+  } // namespace internal
+
+  /**
+   * Like Send_c(), but the data is sent in chunks of checksum_chunk_bytes
+   * followed by a CRC32C per chunk, which Recv_checked_c() verifies. The
+   * checksum of a chunk is computed while it is being sent.
+   *
+   * The datatype has to be contiguous and the receiver must use the same
+   * @p count.
+   */
+  inline int
+  Send_checked_c(const void * buf,
+                 MPI_Count    count,
+                 MPI_Datatype datatype,
+                 int          dest,
+                 int          tag,
+                 MPI_Comm     comm)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Send_checked_c");
+    MPI_Count n_bytes;
+    int       ierr = internal::contiguous_bytes(count, datatype, &n_bytes);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    const MPI_Count            n_chunks = internal::n_checksum_chunks(n_bytes);
+    std::vector<std::uint32_t> digests(n_chunks);
+    MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+
+    // keep at most two chunks in flight
+    for (MPI_Count chunk = 0; chunk < n_chunks; ++chunk)
+      {
+        MPI_COMPAT_TRACE_SCOPE("chunk");
+        const char *data =
+          static_cast<const char *>(buf) + chunk * checksum_chunk_bytes;
+        const int size = internal::checksum_chunk_size(n_bytes, chunk);
+
+        ierr = MPI_Wait(&requests[chunk % 2], MPI_STATUS_IGNORE);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+        ierr = MPI_Isend(
+          data, size, MPI_BYTE, dest, tag, comm, &requests[chunk % 2]);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        digests[chunk] = Crc32c(data, size);
+      }
+    ierr = MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    return Send_c(digests.data(), n_chunks, MPI_UINT32_T, dest, tag, comm);
+  }
+
+  /**
+   * Receive data sent by Send_checked_c() and verify the checksum of every
+   * chunk right after it arrived, while the next chunks are still being
+   * received. Returns MPI_ERR_OTHER if any checksum does not match.
+   *
+   * The datatype has to be contiguous and the sender must use the same
+   * @p count.
+   */
+  inline int
+  Recv_checked_c(void *       buf,
+                 MPI_Count    count,
+                 MPI_Datatype datatype,
+                 int          source,
+                 int          tag,
+                 MPI_Comm     comm,
+                 MPI_Status * status)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Recv_checked_c");
+    MPI_Count n_bytes;
+    int       ierr = internal::contiguous_bytes(count, datatype, &n_bytes);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    const MPI_Count            n_chunks = internal::n_checksum_chunks(n_bytes);
+    std::vector<std::uint32_t> digests(n_chunks);
+    MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    MPI_Status  first_status;
+    bool        mismatch = false;
+
+    char *data = static_cast<char *>(buf);
+    if (n_chunks > 0)
+      {
+        // All chunks have to come from the same message stream, so receive
+        // the first one before posting the others if wildcards are used.
+        if (source == MPI_ANY_SOURCE || tag == MPI_ANY_TAG)
+          {
+            ierr = MPI_Recv(data,
+                            internal::checksum_chunk_size(n_bytes, 0),
+                            MPI_BYTE,
+                            source,
+                            tag,
+                            comm,
+                            &first_status);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+            source = first_status.MPI_SOURCE;
+            tag    = first_status.MPI_TAG;
+          }
+        else
+          {
+            ierr = MPI_Irecv(data,
+                             internal::checksum_chunk_size(n_bytes, 0),
+                             MPI_BYTE,
+                             source,
+                             tag,
+                             comm,
+                             &requests[0]);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+      }
+    if (n_chunks > 1)
+      {
+        ierr = MPI_Irecv(data + checksum_chunk_bytes,
+                         internal::checksum_chunk_size(n_bytes, 1),
+                         MPI_BYTE,
+                         source,
+                         tag,
+                         comm,
+                         &requests[1]);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+
+    std::vector<std::uint32_t> received_digests(n_chunks);
+    for (MPI_Count chunk = 0; chunk < n_chunks; ++chunk)
+      {
+        MPI_COMPAT_TRACE_SCOPE("chunk");
+        if (requests[chunk % 2] != MPI_REQUEST_NULL)
+          {
+            ierr = MPI_Wait(&requests[chunk % 2],
+                            (chunk == 0) ? &first_status : MPI_STATUS_IGNORE);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+
+        if (chunk + 2 < n_chunks)
+          {
+            ierr = MPI_Irecv(data + (chunk + 2) * checksum_chunk_bytes,
+                             internal::checksum_chunk_size(n_bytes, chunk + 2),
+                             MPI_BYTE,
+                             source,
+                             tag,
+                             comm,
+                             &requests[chunk % 2]);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+
+        received_digests[chunk] =
+          Crc32c(data + chunk * checksum_chunk_bytes,
+                 internal::checksum_chunk_size(n_bytes, chunk));
+      }
+
+    ierr = Recv_c(digests.data(),
+                  n_chunks,
+                  MPI_UINT32_T,
+                  source,
+                  tag,
+                  comm,
+                  (n_chunks == 0) ? &first_status : MPI_STATUS_IGNORE);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    for (MPI_Count chunk = 0; chunk < n_chunks; ++chunk)
+      if (digests[chunk] != received_digests[chunk])
+        mismatch = true;
+
+    if (status != MPI_STATUS_IGNORE)
+      {
+        *status = first_status;
+        ierr    = MPI_Status_set_elements_x(status, datatype, count);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+
+    return mismatch ? MPI_ERR_OTHER : MPI_SUCCESS;
+  }
+
+  /**
+   * Like Bcast_c(), but the data is broadcast in chunks of
+   * checksum_chunk_bytes followed by a CRC32C per chunk computed on
+   * @p root. All other processes verify each chunk right after it
+   * arrived and return MPI_ERR_OTHER if any checksum does not match.
+   *
+   * The datatype has to be contiguous.
+   */
+  inline int
+  Bcast_checked_c(void *       buf,
+                  MPI_Count    count,
+                  MPI_Datatype datatype,
+                  int          root,
+                  MPI_Comm     comm)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Bcast_checked_c");
+    int myid;
+    int ierr = MPI_Comm_rank(comm, &myid);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    MPI_Count n_bytes;
+    ierr = internal::contiguous_bytes(count, datatype, &n_bytes);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    const MPI_Count            n_chunks = internal::n_checksum_chunks(n_bytes);
+    std::vector<std::uint32_t> digests(n_chunks);
+    std::vector<std::uint32_t> received_digests(n_chunks);
+    MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+
+    // With two broadcasts in flight, the checksum of one chunk is computed
+    // while the next one is transferred.
+    char *data = static_cast<char *>(buf);
+    for (MPI_Count chunk = 0; chunk < n_chunks + 1; ++chunk)
+      {
+        MPI_COMPAT_TRACE_SCOPE("chunk");
+        if (chunk < n_chunks)
+          {
+            ierr = MPI_Ibcast(data + chunk * checksum_chunk_bytes,
+                              internal::checksum_chunk_size(n_bytes, chunk),
+                              MPI_BYTE,
+                              root,
+                              comm,
+                              &requests[chunk % 2]);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+
+        if (chunk > 0)
+          {
+            const MPI_Count previous = chunk - 1;
+            // the root may compute the checksum while sending
+            if (myid != root)
+              {
+                ierr = MPI_Wait(&requests[previous % 2], MPI_STATUS_IGNORE);
+                if (ierr != MPI_SUCCESS)
+                  return ierr;
+              }
+            received_digests[previous] =
+              Crc32c(data + previous * checksum_chunk_bytes,
+                     internal::checksum_chunk_size(n_bytes, previous));
+            ierr = MPI_Wait(&requests[previous % 2], MPI_STATUS_IGNORE);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+      }
+
+    if (myid == root)
+      digests = received_digests;
+    ierr = Bcast_c(digests.data(), n_chunks, MPI_UINT32_T, root, comm);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    return (digests == received_digests) ? MPI_SUCCESS : MPI_ERR_OTHER;
+  }
+
+  /**
+   * Return in @p extent the number of bytes File_write_at_checked_c() and
+   * File_write_at_all_checked_c() occupy in the file for @p count elements
+   * of @p datatype: the data itself, followed by the CRC32C of every chunk
+   * of checksum_chunk_bytes as MPI_UINT32_T in native representation.
+   */
+  inline int
+  File_checked_extent_c(MPI_Count    count,
+                        MPI_Datatype datatype,
+                        MPI_Offset * extent)
+  {
+    MPI_Count n_bytes;
+    int       ierr = internal::contiguous_bytes(count, datatype, &n_bytes);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    *extent = n_bytes + internal::n_checksum_chunks(n_bytes) *
+                          static_cast<MPI_Offset>(sizeof(std::uint32_t));
+    return MPI_SUCCESS;
+  }
+
+  /**
+   * Like File_write_at_c(), but the data is written in chunks of
+   * checksum_chunk_bytes and the CRC32C of every chunk is computed while
+   * it is being written. The checksums are stored in the file right after
+   * the data (see File_checked_extent_c()), where File_read_at_checked_c()
+   * finds them.
+   *
+   * The datatype has to be contiguous and the file view has to use MPI_BYTE
+   * as elementary type, like the default view.
+   */
+  inline int
+  File_write_at_checked_c(MPI_File     fh,
+                          MPI_Offset   offset,
+                          const void * buf,
+                          MPI_Count    count,
+                          MPI_Datatype datatype,
+                          MPI_Status * status)
+  {
+    MPI_COMPAT_TRACE_SCOPE("File_write_at_checked_c");
+    MPI_Count n_bytes;
+    int       ierr = internal::contiguous_bytes(count, datatype, &n_bytes);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    const MPI_Count            n_chunks = internal::n_checksum_chunks(n_bytes);
+    std::vector<std::uint32_t> digests(n_chunks);
+    MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+
+    for (MPI_Count chunk = 0; chunk < n_chunks; ++chunk)
+      {
+        MPI_COMPAT_TRACE_SCOPE("chunk");
+        const char *data =
+          static_cast<const char *>(buf) + chunk * checksum_chunk_bytes;
+        const int size = internal::checksum_chunk_size(n_bytes, chunk);
+
+        ierr = MPI_Wait(&requests[chunk % 2], MPI_STATUS_IGNORE);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+        ierr = MPI_File_iwrite_at(fh,
+                                  offset + chunk * checksum_chunk_bytes,
+                                  data,
+                                  size,
+                                  MPI_BYTE,
+                                  &requests[chunk % 2]);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        digests[chunk] = Crc32c(data, size);
+      }
+    ierr = MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = File_write_at_c(fh,
+                           offset + n_bytes,
+                           digests.data(),
+                           n_chunks,
+                           MPI_UINT32_T,
+                           MPI_STATUS_IGNORE);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    if (status != MPI_STATUS_IGNORE)
+      return MPI_Status_set_elements_x(status, datatype, count);
+    return MPI_SUCCESS;
+  }
+
+  /**
+   * Like File_read_at_c(), but the data is read in chunks of
+   * checksum_chunk_bytes and every chunk is verified against the checksums
+   * stored by File_write_at_checked_c() while the next one is being read.
+   * Returns MPI_ERR_OTHER if any checksum does not match.
+   *
+   * The datatype has to be contiguous and the file view has to use MPI_BYTE
+   * as elementary type, like the default view.
+   */
+  inline int
+  File_read_at_checked_c(MPI_File     fh,
+                         MPI_Offset   offset,
+                         void *       buf,
+                         MPI_Count    count,
+                         MPI_Datatype datatype,
+                         MPI_Status * status)
+  {
+    MPI_COMPAT_TRACE_SCOPE("File_read_at_checked_c");
+    MPI_Count n_bytes;
+    int       ierr = internal::contiguous_bytes(count, datatype, &n_bytes);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    const MPI_Count            n_chunks = internal::n_checksum_chunks(n_bytes);
+    std::vector<std::uint32_t> digests(n_chunks);
+    MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    bool        mismatch    = false;
+    char *      data        = static_cast<char *>(buf);
+
+    ierr = File_read_at_c(fh,
+                          offset + n_bytes,
+                          digests.data(),
+                          n_chunks,
+                          MPI_UINT32_T,
+                          MPI_STATUS_IGNORE);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    for (MPI_Count chunk = 0; chunk < n_chunks + 1; ++chunk)
+      {
+        MPI_COMPAT_TRACE_SCOPE("chunk");
+        if (chunk < n_chunks)
+          {
+            ierr = MPI_File_iread_at(fh,
+                                     offset + chunk * checksum_chunk_bytes,
+                                     data + chunk * checksum_chunk_bytes,
+                                     internal::checksum_chunk_size(n_bytes,
+                                                                   chunk),
+                                     MPI_BYTE,
+                                     &requests[chunk % 2]);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+
+        if (chunk > 0)
+          {
+            const MPI_Count previous = chunk - 1;
+            ierr = MPI_Wait(&requests[previous % 2], MPI_STATUS_IGNORE);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+            if (Crc32c(data + previous * checksum_chunk_bytes,
+                       internal::checksum_chunk_size(n_bytes, previous)) !=
+                digests[previous])
+              mismatch = true;
+          }
+      }
+
+    if (status != MPI_STATUS_IGNORE)
+      {
+        ierr = MPI_Status_set_elements_x(status, datatype, count);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+    return mismatch ? MPI_ERR_OTHER : MPI_SUCCESS;
+  }
+
+  namespace internal
+  {
+    /**
+     * File_write_at_all_checked_c() and File_read_at_all_checked_c()
+     * access the data in this many collective steps, independent of the
+     * amount of data on each process, so that all processes make the same
+     * number of collective calls.
+     */
+    static constexpr MPI_Count checked_all_steps = 8;
+
+    /**
+     * Return the first checksum chunk of @p n_chunks accessed in @p step
+     * of File_write_at_all_checked_c() and File_read_at_all_checked_c().
+     */
+    inline MPI_Count
+    checked_all_first_chunk(MPI_Count n_chunks, MPI_Count step)
+    {
+      return n_chunks * step / checked_all_steps;
+    }
+
+    /**
+     * Start to write (if @p write is true) or read @p step of the
+     * @p n_bytes of @p data at @p offset collectively, with @p type
+     * created for it. Before MPI 3.1, the access is blocking and
+     * @p request is set to MPI_REQUEST_NULL. Steps without data take part
+     * with an empty access.
+     */
+    inline int
+    checked_all_start_step(MPI_File      fh,
+                           MPI_Offset    offset,
+                           char *        data,
+                           MPI_Count     n_bytes,
+                           MPI_Count     step,
+                           bool          write,
+                           MPI_Datatype *type,
+                           MPI_Request * request)
+    {
+      const MPI_Count n_chunks = n_checksum_chunks(n_bytes);
+      const MPI_Count begin =
+        checked_all_first_chunk(n_chunks, step) * checksum_chunk_bytes;
+      const MPI_Count end = std::min(
+        n_bytes,
+        checked_all_first_chunk(n_chunks, step + 1) * checksum_chunk_bytes);
+
+      // a derived type of size zero is not handled by all implementations
+      if (end > begin)
+        {
+          const int ierr = Type_contiguous_c(end - begin, MPI_BYTE, type);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+        }
+      const int          step_count = (end > begin) ? 1 : 0;
+      const MPI_Datatype step_type  = (end > begin) ? *type : MPI_BYTE;
+
+#ifdef MPI_COMPAT_HAVE_NONBLOCKING_COLLECTIVE_IO
+      if (write)
+        return MPI_File_iwrite_at_all(
+          fh, offset + begin, data + begin, step_count, step_type, request);
+      return MPI_File_iread_at_all(
+        fh, offset + begin, data + begin, step_count, step_type, request);
+#else
+      *request = MPI_REQUEST_NULL;
+      if (write)
+        return MPI_File_write_at_all(fh,
+                                     offset + begin,
+                                     data + begin,
+                                     step_count,
+                                     step_type,
+                                     MPI_STATUS_IGNORE);
+      return MPI_File_read_at_all(fh,
+                                  offset + begin,
+                                  data + begin,
+                                  step_count,
+                                  step_type,
+                                  MPI_STATUS_IGNORE);
+#endif
+    }
+
+    /**
+     * Wait for the access started by checked_all_start_step() and free
+     * its @p type.
+     */
+    inline int
+    checked_all_finish_step(MPI_Datatype *type, MPI_Request *request)
+    {
+      const int ierr = MPI_Wait(request, MPI_STATUS_IGNORE);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      if (*type != MPI_DATATYPE_NULL)
+        return MPI_Type_free(type);
+      return MPI_SUCCESS;
+    }
+  } // namespace internal
+
+  /**
+   * Collective version of File_write_at_checked_c(). The data is written
+   * in checked_all_steps nonblocking collective operations with two in
+   * flight, and the checksums of a step are computed while the previous
+   * step is being written. They are then written collectively after the
+   * data. Before MPI 3.1, the steps are blocking.
+   */
+  inline int
+  File_write_at_all_checked_c(MPI_File     fh,
+                              MPI_Offset   offset,
+                              const void * buf,
+                              MPI_Count    count,
+                              MPI_Datatype datatype,
+                              MPI_Status * status)
+  {
+    MPI_COMPAT_TRACE_SCOPE("File_write_at_all_checked_c");
+    MPI_Count n_bytes;
+    int       ierr = internal::contiguous_bytes(count, datatype, &n_bytes);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    const MPI_Count            n_chunks = internal::n_checksum_chunks(n_bytes);
+    std::vector<std::uint32_t> digests(n_chunks);
+    MPI_Request  requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    MPI_Datatype types[2]    = {MPI_DATATYPE_NULL, MPI_DATATYPE_NULL};
+    char *       data        = static_cast<char *>(const_cast<void *>(buf));
+
+    for (MPI_Count step = 0; step < internal::checked_all_steps + 1; ++step)
+      {
+        MPI_COMPAT_TRACE_SCOPE("chunk");
+        if (step < internal::checked_all_steps)
+          {
+            // the data of a step must not be accessed while it is written
+            for (MPI_Count chunk =
+                   internal::checked_all_first_chunk(n_chunks, step);
+                 chunk < internal::checked_all_first_chunk(n_chunks, step + 1);
+                 ++chunk)
+              digests[chunk] =
+                Crc32c(data + chunk * checksum_chunk_bytes,
+                       internal::checksum_chunk_size(n_bytes, chunk));
+
+            ierr = internal::checked_all_start_step(fh,
+                                                    offset,
+                                                    data,
+                                                    n_bytes,
+                                                    step,
+                                                    true,
+                                                    &types[step % 2],
+                                                    &requests[step % 2]);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+
+        if (step > 0)
+          {
+            const MPI_Count previous = step - 1;
+            ierr = internal::checked_all_finish_step(&types[previous % 2],
+                                                     &requests[previous % 2]);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+      }
+
+    ierr = File_write_at_all_c(fh,
+                               offset + n_bytes,
+                               digests.data(),
+                               n_chunks,
+                               MPI_UINT32_T,
+                               MPI_STATUS_IGNORE);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    if (status != MPI_STATUS_IGNORE)
+      return MPI_Status_set_elements_x(status, datatype, count);
+    return MPI_SUCCESS;
+  }
+
+  /**
+   * Collective version of File_read_at_checked_c(). The data is read in
+   * checked_all_steps nonblocking collective operations with two in
+   * flight, and the chunks of one step are verified while the next step is
+   * being read. Before MPI 3.1, the steps are blocking.
+   */
+  inline int
+  File_read_at_all_checked_c(MPI_File     fh,
+                             MPI_Offset   offset,
+                             void *       buf,
+                             MPI_Count    count,
+                             MPI_Datatype datatype,
+                             MPI_Status * status)
+  {
+    MPI_COMPAT_TRACE_SCOPE("File_read_at_all_checked_c");
+    MPI_Count n_bytes;
+    int       ierr = internal::contiguous_bytes(count, datatype, &n_bytes);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    const MPI_Count            n_chunks = internal::n_checksum_chunks(n_bytes);
+    std::vector<std::uint32_t> digests(n_chunks);
+    ierr = File_read_at_all_c(fh,
+                              offset + n_bytes,
+                              digests.data(),
+                              n_chunks,
+                              MPI_UINT32_T,
+                              MPI_STATUS_IGNORE);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    MPI_Request  requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    MPI_Datatype types[2]    = {MPI_DATATYPE_NULL, MPI_DATATYPE_NULL};
+    bool         mismatch    = false;
+    char *       data        = static_cast<char *>(buf);
+
+    for (MPI_Count step = 0; step < internal::checked_all_steps + 1; ++step)
+      {
+        MPI_COMPAT_TRACE_SCOPE("chunk");
+        if (step < internal::checked_all_steps)
+          {
+            ierr = internal::checked_all_start_step(fh,
+                                                    offset,
+                                                    data,
+                                                    n_bytes,
+                                                    step,
+                                                    false,
+                                                    &types[step % 2],
+                                                    &requests[step % 2]);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+
+        if (step > 0)
+          {
+            const MPI_Count previous = step - 1;
+            ierr = internal::checked_all_finish_step(&types[previous % 2],
+                                                     &requests[previous % 2]);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+
+            for (MPI_Count chunk =
+                   internal::checked_all_first_chunk(n_chunks, previous);
+                 chunk < internal::checked_all_first_chunk(n_chunks, step);
+                 ++chunk)
+              if (Crc32c(data + chunk * checksum_chunk_bytes,
+                         internal::checksum_chunk_size(n_bytes, chunk)) !=
+                  digests[chunk])
+                mismatch = true;
+          }
+      }
+
+    if (status != MPI_STATUS_IGNORE)
+      {
+        ierr = MPI_Status_set_elements_x(status, datatype, count);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+    return mismatch ? MPI_ERR_OTHER : MPI_SUCCESS;
+  }
+
+  /**
+   * Algorithms for the collectives below that can aggregate data per
+   * compute node.
+   */
+  enum class CollectiveAlgorithm
+  {
+    /**
+     * Let the root communicate with every process directly.
+     */
+    direct,
+    /**
+     * Combine the data of all processes on a node (sharing memory) first,
+     * so that the root exchanges one large message per node instead of
+     * many smaller ones with every process.
+     */
+    node_aggregated
+  };
+
+  namespace internal
+  {
+    /**
+     * Attribute delete callback freeing a communicator cached with
+     * cached_comm().
+     */
+    inline int
+    free_comm_attribute(MPI_Comm, int, void *attribute, void *)
+    {
+      MPI_Comm *cached = static_cast<MPI_Comm *>(attribute);
+      int       ierr   = MPI_SUCCESS;
+      if (*cached != MPI_COMM_NULL)
+        ierr = MPI_Comm_free(cached);
+      delete cached;
+      return ierr;
+    }
+
+    /**
+     * Return in @p result the communicator cached on @p comm under
+     * @p keyval and create it with @p create on first use. This is
+     * collective if the communicator has to be created.
+     */
+    template <typename Create>
+    inline int
+    cached_comm(MPI_Comm comm, int &keyval, Create create, MPI_Comm *result)
+    {
+      int ierr;
+      if (keyval == MPI_KEYVAL_INVALID)
+        {
+          ierr = MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN,
+                                        &free_comm_attribute,
+                                        &keyval,
+                                        nullptr);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+        }
+
+      void *attribute;
+      int   flag;
+      ierr = MPI_Comm_get_attr(comm, keyval, &attribute, &flag);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      if (flag)
+        {
+          *result = *static_cast<MPI_Comm *>(attribute);
+          return MPI_SUCCESS;
+        }
+
+      MPI_Comm *cached = new MPI_Comm;
+      ierr             = create(cached);
+      if (ierr != MPI_SUCCESS)
+        {
+          delete cached;
+          return ierr;
+        }
+      ierr = MPI_Comm_set_attr(comm, keyval, cached);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      *result = *cached;
+      return MPI_SUCCESS;
+    }
+
+    /**
+     * Return a duplicate of @p comm for the point-to-point messages of the
+     * collectives implemented here, so that they can not be matched by
+     * receives of the user.
+     */
+    inline int
+    private_comm(MPI_Comm comm, MPI_Comm *result)
+    {
+      static int keyval = MPI_KEYVAL_INVALID;
+      return cached_comm(
+        comm,
+        keyval,
+        [comm](MPI_Comm *created) { return MPI_Comm_dup(comm, created); },
+        result);
+    }
+
+    /**
+     * Attribute delete callback freeing the tag counter of
+     * collective_comm().
+     */
+    inline int
+    free_counter_attribute(MPI_Comm, int, void *attribute, void *)
+    {
+      delete static_cast<int *>(attribute);
+      return MPI_SUCCESS;
+    }
+
+    /**
+     * Return in @p result the communicator of private_comm() and in @p tag
+     * the tag for the messages of one collective operation on @p comm,
+     * taken from a counter on @p result that wraps around at MPI_TAG_UB.
+     * Collectives are started in the same order on all processes, so they
+     * agree on the tag, and the messages of collectives that are in flight
+     * at the same time can not match each other. This has to be called by
+     * all processes of @p comm.
+     */
+    inline int
+    collective_comm(MPI_Comm comm, MPI_Comm *result, int *tag)
+    {
+      int ierr = private_comm(comm, result);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      static int keyval = MPI_KEYVAL_INVALID;
+      if (keyval == MPI_KEYVAL_INVALID)
+        {
+          ierr = MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN,
+                                        &free_counter_attribute,
+                                        &keyval,
+                                        nullptr);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+        }
+
+      void *attribute;
+      int   flag;
+      ierr = MPI_Comm_get_attr(*result, keyval, &attribute, &flag);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      if (!flag)
+        {
+          attribute = new int(0);
+          ierr      = MPI_Comm_set_attr(*result, keyval, attribute);
+          if (ierr != MPI_SUCCESS)
+            {
+              delete static_cast<int *>(attribute);
+              return ierr;
+            }
+        }
+
+      // MPI_TAG_UB is only attached to MPI_COMM_WORLD, and at least 32767
+      void *tag_ub;
+      ierr = MPI_Comm_get_attr(MPI_COMM_WORLD, MPI_TAG_UB, &tag_ub, &flag);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      const int max_tag = flag ? *static_cast<int *>(tag_ub) : 32767;
+
+      int *next = static_cast<int *>(attribute);
+      *tag      = *next;
+      *next     = (*next < max_tag) ? *next + 1 : 0;
+      return MPI_SUCCESS;
+    }
+
+    /**
+     * Return the communicator of all processes in @p comm that share memory
+     * with this one, ordered like in @p comm.
+     */
+    inline int
+    node_comm(MPI_Comm comm, MPI_Comm *result)
+    {
+      static int keyval = MPI_KEYVAL_INVALID;
+      return cached_comm(
+        comm,
+        keyval,
+        [comm](MPI_Comm *created) {
+          return MPI_Comm_split_type(
+            comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, created);
+        },
+        result);
+    }
+
+    /**
+     * Return the communicator of the first processes of all nodes in
+     * @p comm, ordered like in @p comm, or MPI_COMM_NULL on all other
+     * processes.
+     */
+    inline int
+    leaders_comm(MPI_Comm comm, MPI_Comm *result)
+    {
+      static int keyval = MPI_KEYVAL_INVALID;
+      return cached_comm(
+        comm,
+        keyval,
+        [comm](MPI_Comm *created) {
+          MPI_Comm node;
+          int      ierr = node_comm(comm, &node);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+          int node_rank;
+          ierr = MPI_Comm_rank(node, &node_rank);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+          return MPI_Comm_split(
+            comm, (node_rank == 0) ? 0 : MPI_UNDEFINED, 0, created);
+        },
+        result);
+    }
+
+    /**
+     * Wait for all @p requests started by BigMPICompat and clear them.
+     */
+    inline int
+    wait_all(std::vector<MPI_Request> &requests)
+    {
+      for (MPI_Request &request : requests)
+        {
+          const int ierr = Wait(&request, MPI_STATUS_IGNORE);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+        }
+      requests.clear();
+      return MPI_SUCCESS;
+    }
+
+    /**
+     * For the processes @p members, create a datatype that describes their
+     * blocks of @p counts elements of @p datatype at the displacements
+     * @p displs (in units of its extent) relative to a buffer. Processes
+     * without data are skipped and @p n_blocks is set to the number of
+     * remaining blocks; if it is zero, no type is created.
+     *
+     * The blocks ignore the strategy selected with Type_set_strategy(), so
+     * that the type signature always matches the packed type created by
+     * create_packed_type() for the same elements.
+     */
+    inline int
+    create_blocks_type(const std::vector<int> &members,
+                       const MPI_Count         counts[],
+                       const MPI_Aint          displs[],
+                       MPI_Datatype            datatype,
+                       int                     skip_member,
+                       MPI_Datatype *          newtype,
+                       int *                   n_blocks)
+    {
+      int      ierr;
+      MPI_Aint lb, extent;
+      ierr = MPI_Type_get_extent(datatype, &lb, &extent);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      std::vector<int>          blocklengths;
+      std::vector<MPI_Aint>     displacements;
+      std::vector<MPI_Datatype> types;
+      for (const int member : members)
+        if (member != skip_member && counts[member] > 0)
+          {
+            MPI_Datatype block;
+            ierr = Type_contiguous_c(counts[member],
+                                     datatype,
+                                     &block,
+                                     TypeStrategy::standard);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+            blocklengths.push_back(1);
+            displacements.push_back(displs[member] * extent);
+            types.push_back(block);
+          }
+
+      *n_blocks = types.size();
+      if (types.empty())
+        return MPI_SUCCESS;
+
+      ierr = MPI_Type_create_struct(types.size(),
+                                    blocklengths.data(),
+                                    displacements.data(),
+                                    types.data(),
+                                    newtype);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      ierr = MPI_Type_commit(newtype);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      for (MPI_Datatype &block : types)
+        {
+          ierr = MPI_Type_free(&block);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+        }
+      return MPI_SUCCESS;
+    }
+
+    /**
+     * Create a type of @p count elements of @p datatype for the data packed
+     * on the first process of a node, whose peer uses a type created by
+     * create_blocks_type(). Like there, the strategy selected with
+     * Type_set_strategy() is ignored: with TypeStrategy::bytes, the two
+     * types would not have the same signature.
+     */
+    inline int
+    create_packed_type(MPI_Count     count,
+                       MPI_Datatype  datatype,
+                       MPI_Datatype *newtype)
+    {
+      return Type_contiguous_c(count,
+                               datatype,
+                               newtype,
+                               TypeStrategy::standard);
+    }
+
+    /**
+     * Data about the nodes needed by the node aggregated algorithms:
+     * the rank of this process in @p node and the size of @p node, the
+     * rank in @p comm of the first process on the node of every process
+     * (only on @p root), and the counts of all processes on this node (only
+     * on the first process of the node).
+     */
+    struct NodeLayout
+    {
+      MPI_Comm               node;
+      int                    node_rank;
+      int                    node_size;
+      std::vector<int>       leaders;
+      std::vector<MPI_Count> node_counts;
+      std::vector<MPI_Aint>  node_displs;
+      MPI_Count              node_total = 0;
+    };
+
+    /**
+     * Set up @p layout for the node aggregated algorithms, where this
+     * process contributes @p count elements.
+     */
+    inline int
+    setup_node_layout(MPI_Count   count,
+                      int         root,
+                      MPI_Comm    comm,
+                      NodeLayout &layout)
+    {
+      int myid, n_ranks;
+      int ierr = MPI_Comm_rank(comm, &myid);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      ierr = MPI_Comm_size(comm, &n_ranks);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      ierr = node_comm(comm, &layout.node);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      ierr = MPI_Comm_rank(layout.node, &layout.node_rank);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      ierr = MPI_Comm_size(layout.node, &layout.node_size);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      int leader = myid;
+      ierr       = MPI_Bcast(&leader, 1, MPI_INT, 0, layout.node);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      layout.leaders.resize((myid == root) ? n_ranks : 0);
+      ierr = MPI_Gather(
+        &leader, 1, MPI_INT, layout.leaders.data(), 1, MPI_INT, root, comm);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      layout.node_counts.resize((layout.node_rank == 0) ? layout.node_size :
+                                                          0);
+      ierr = MPI_Gather(&count,
+                        1,
+                        MPI_COUNT,
+                        layout.node_counts.data(),
+                        1,
+                        MPI_COUNT,
+                        0,
+                        layout.node);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      layout.node_displs.resize(layout.node_counts.size());
+      layout.node_total = 0;
+      for (unsigned int i = 0; i < layout.node_counts.size(); ++i)
+        {
+          layout.node_displs[i] = layout.node_total;
+          layout.node_total += layout.node_counts[i];
+        }
+      return MPI_SUCCESS;
+    }
+
+    /**
+     * Return a map from the first process of every node to all processes
+     * on that node, computed from the @p leaders of a NodeLayout.
+     */
+    inline std::map<int, std::vector<int>>
+    node_members(const std::vector<int> &leaders)
+    {
+      std::map<int, std::vector<int>> members;
+      for (unsigned int i = 0; i < leaders.size(); ++i)
+        members[leaders[i]].push_back(i);
+      return members;
+    }
+  } // namespace internal
+
+  /**
+   * Gather a (possibly large) @p sendcount from every process into
+   * @p recvbuf on @p root, where the data of process i is stored at
+   * @p displs[i] (in units of the extent of @p recvtype).
+   *
+   * Without native support, the root first broadcasts whether all counts
+   * and displacements fit into an int. If they do, MPI_Gatherv() is used,
+   * otherwise every process sends its data to the root directly.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Gatherv_c(const void *    sendbuf,
+            MPI_Count       sendcount,
+            MPI_Datatype    sendtype,
+            void *          recvbuf,
+            const MPI_Count recvcounts[],
+            const MPI_Aint  displs[],
+            MPI_Datatype    recvtype,
+            int             root,
+            MPI_Comm        comm)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Gatherv_c");
+#if MPI_VERSION >= 4
+    return MPI_Gatherv_c(sendbuf,
+                         sendcount,
+                         sendtype,
+                         recvbuf,
+                         recvcounts,
+                         displs,
+                         recvtype,
+                         root,
+                         comm);
+#else
+    int myid, n_ranks;
+    int ierr = MPI_Comm_rank(comm, &myid);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = MPI_Comm_size(comm, &n_ranks);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    int              fits = 1;
+    std::vector<int> int_counts, int_displs;
+    if (myid == root)
+      for (int i = 0; i < n_ranks; ++i)
+        {
+          if (recvcounts[i] > BigMPICompat::mpi_max_int_count ||
+              displs[i] > BigMPICompat::mpi_max_int_count ||
+              displs[i] < -BigMPICompat::mpi_max_int_count)
+            fits = 0;
+          int_counts.push_back(recvcounts[i]);
+          int_displs.push_back(displs[i]);
+        }
+    ierr = MPI_Bcast(&fits, 1, MPI_INT, root, comm);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    const bool in_place = (myid == root && sendbuf == MPI_IN_PLACE);
+
+    if (fits)
+      {
+        if (sendcount <= BigMPICompat::mpi_max_int_count || in_place)
+          return MPI_Gatherv(sendbuf,
+                             sendcount,
+                             sendtype,
+                             recvbuf,
+                             int_counts.data(),
+                             int_displs.data(),
+                             recvtype,
+                             root,
+                             comm);
+
+        MPI_Datatype bigtype;
+        ierr = Type_contiguous_c(sendcount, sendtype, &bigtype);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        ierr = MPI_Gatherv(sendbuf,
+                           1,
+                           bigtype,
+                           recvbuf,
+                           int_counts.data(),
+                           int_displs.data(),
+                           recvtype,
+                           root,
+                           comm);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        return MPI_Type_free(&bigtype);
+      }
+
+    MPI_Comm private_comm;
+    int      tag;
+    ierr = internal::collective_comm(comm, &private_comm, &tag);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    std::vector<MPI_Request> requests;
+    if (myid == root)
+      {
+        MPI_Aint lb, extent;
+        ierr = MPI_Type_get_extent(recvtype, &lb, &extent);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        for (int i = 0; i < n_ranks; ++i)
+          if (recvcounts[i] > 0 && !(i == root && in_place))
+            {
+              requests.push_back(MPI_REQUEST_NULL);
+              ierr = Irecv_c(static_cast<char *>(recvbuf) + displs[i] * extent,
+                             recvcounts[i],
+                             recvtype,
+                             i,
+                             tag,
+                             private_comm,
+                             &requests.back());
+              if (ierr != MPI_SUCCESS)
+                return ierr;
+            }
+      }
+    if (sendcount > 0 && !in_place)
+      {
+        requests.push_back(MPI_REQUEST_NULL);
+        ierr = Isend_c(sendbuf,
+                       sendcount,
+                       sendtype,
+                       root,
+                       tag,
+                       private_comm,
+                       &requests.back());
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+
+    return internal::wait_all(requests);
+#endif
+  }
+
+  /**
+   * Like Gatherv_c() above, but with a choice of @p algorithm.
+   *
+   * With CollectiveAlgorithm::node_aggregated, the processes on each node
+   * first gather their data on the first process of the node, which then
+   * sends it to the root as a single message that the root receives
+   * directly into place. All processes must use the same @p sendtype.
+   */
+  inline int
+  Gatherv_c(const void *        sendbuf,
+            MPI_Count           sendcount,
+            MPI_Datatype        sendtype,
+            void *              recvbuf,
+            const MPI_Count     recvcounts[],
+            const MPI_Aint      displs[],
+            MPI_Datatype        recvtype,
+            int                 root,
+            MPI_Comm            comm,
+            CollectiveAlgorithm algorithm)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Gatherv_c");
+    if (algorithm == CollectiveAlgorithm::direct)
+      return Gatherv_c(sendbuf,
+                       sendcount,
+                       sendtype,
+                       recvbuf,
+                       recvcounts,
+                       displs,
+                       recvtype,
+                       root,
+                       comm);
+
+    int myid;
+    int ierr = MPI_Comm_rank(comm, &myid);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    // with MPI_IN_PLACE the data of the root is already where it belongs
+    const bool      in_place = (myid == root && sendbuf == MPI_IN_PLACE);
+    const MPI_Count count    = in_place ? 0 : sendcount;
+
+    internal::NodeLayout layout;
+    ierr = internal::setup_node_layout(count, root, comm, layout);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    MPI_Aint lb, send_extent;
+    ierr = MPI_Type_get_extent(sendtype, &lb, &send_extent);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    std::vector<char> packed(layout.node_total * send_extent);
+    ierr = Gatherv_c(in_place ? nullptr : sendbuf,
+                     count,
+                     sendtype,
+                     packed.data(),
+                     layout.node_counts.data(),
+                     layout.node_displs.data(),
+                     sendtype,
+                     0,
+                     layout.node);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    MPI_Comm private_comm;
+    int      tag;
+    ierr = internal::collective_comm(comm, &private_comm, &tag);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    std::vector<MPI_Request> requests;
+    if (myid == root)
+      for (const auto &node : internal::node_members(layout.leaders))
+        {
+          MPI_Datatype node_type;
+          int          n_blocks;
+          ierr = internal::create_blocks_type(node.second,
+                                              recvcounts,
+                                              displs,
+                                              recvtype,
+                                              in_place ? root : -1,
+                                              &node_type,
+                                              &n_blocks);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+          if (n_blocks == 0)
+            continue;
+
+          requests.push_back(MPI_REQUEST_NULL);
+          ierr = Irecv_c(recvbuf,
+                         1,
+                         node_type,
+                         node.first,
+                         tag,
+                         private_comm,
+                         &requests.back());
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+          ierr = MPI_Type_free(&node_type);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+        }
+    if (layout.node_rank == 0 && layout.node_total > 0)
+      {
+        MPI_Datatype packed_type;
+        ierr = internal::create_packed_type(layout.node_total,
+                                            sendtype,
+                                            &packed_type);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        requests.push_back(MPI_REQUEST_NULL);
+        ierr = Isend_c(packed.data(),
+                       1,
+                       packed_type,
+                       root,
+                       tag,
+                       private_comm,
+                       &requests.back());
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+        ierr = MPI_Type_free(&packed_type);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+
+    return internal::wait_all(requests);
+  }
+
+  /**
+   * Scatter a (possibly large) @p sendcounts[i] elements stored at
+   * @p displs[i] (in units of the extent of @p sendtype) of @p sendbuf on
+   * @p root to every process i.
+   *
+   * Without native support, the root first broadcasts whether all counts
+   * and displacements fit into an int. If they do, MPI_Scatterv() is used,
+   * otherwise the root sends the data to every process directly.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Scatterv_c(const void *    sendbuf,
+             const MPI_Count sendcounts[],
+             const MPI_Aint  displs[],
+             MPI_Datatype    sendtype,
+             void *          recvbuf,
+             MPI_Count       recvcount,
+             MPI_Datatype    recvtype,
+             int             root,
+             MPI_Comm        comm)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Scatterv_c");
+#if MPI_VERSION >= 4
+    return MPI_Scatterv_c(sendbuf,
+                          sendcounts,
+                          displs,
+                          sendtype,
+                          recvbuf,
+                          recvcount,
+                          recvtype,
+                          root,
+                          comm);
+#else
+    int myid, n_ranks;
+    int ierr = MPI_Comm_rank(comm, &myid);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = MPI_Comm_size(comm, &n_ranks);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    int              fits = 1;
+    std::vector<int> int_counts, int_displs;
+    if (myid == root)
+      for (int i = 0; i < n_ranks; ++i)
+        {
+          if (sendcounts[i] > BigMPICompat::mpi_max_int_count ||
+              displs[i] > BigMPICompat::mpi_max_int_count ||
+              displs[i] < -BigMPICompat::mpi_max_int_count)
+            fits = 0;
+          int_counts.push_back(sendcounts[i]);
+          int_displs.push_back(displs[i]);
+        }
+    ierr = MPI_Bcast(&fits, 1, MPI_INT, root, comm);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    const bool in_place = (myid == root && recvbuf == MPI_IN_PLACE);
+
+    if (fits)
+      {
+        if (recvcount <= BigMPICompat::mpi_max_int_count || in_place)
+          return MPI_Scatterv(sendbuf,
+                              int_counts.data(),
+                              int_displs.data(),
+                              sendtype,
+                              recvbuf,
+                              recvcount,
+                              recvtype,
+                              root,
+                              comm);
+
+        MPI_Datatype bigtype;
+        ierr = Type_contiguous_c(recvcount, recvtype, &bigtype);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        ierr = MPI_Scatterv(sendbuf,
+                            int_counts.data(),
+                            int_displs.data(),
+                            sendtype,
+                            recvbuf,
+                            1,
+                            bigtype,
+                            root,
+                            comm);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        return MPI_Type_free(&bigtype);
+      }
+
+    MPI_Comm private_comm;
+    int      tag;
+    ierr = internal::collective_comm(comm, &private_comm, &tag);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    std::vector<MPI_Request> requests;
+    if (recvcount > 0 && !in_place)
+      {
+        requests.push_back(MPI_REQUEST_NULL);
+        ierr = Irecv_c(recvbuf,
+                       recvcount,
+                       recvtype,
+                       root,
+                       tag,
+                       private_comm,
+                       &requests.back());
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+    if (myid == root)
+      {
+        MPI_Aint lb, extent;
+        ierr = MPI_Type_get_extent(sendtype, &lb, &extent);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        for (int i = 0; i < n_ranks; ++i)
+          if (sendcounts[i] > 0 && !(i == root && in_place))
+            {
+              requests.push_back(MPI_REQUEST_NULL);
+              ierr = Isend_c(static_cast<const char *>(sendbuf) +
+                               displs[i] * extent,
+                             sendcounts[i],
+                             sendtype,
+                             i,
+                             tag,
+                             private_comm,
+                             &requests.back());
+              if (ierr != MPI_SUCCESS)
+                return ierr;
+            }
+      }
+
+    return internal::wait_all(requests);
+#endif
+  }
+
+  /**
+   * Like Scatterv_c() above, but with a choice of @p algorithm.
+   *
+   * With CollectiveAlgorithm::node_aggregated, the root sends the data of
+   * all processes on a node as a single message, taken directly from
+   * @p sendbuf, to the first process of the node, which then scatters it
+   * on the node. All processes must use the same @p recvtype.
+   */
+  inline int
+  Scatterv_c(const void *        sendbuf,
+             const MPI_Count     sendcounts[],
+             const MPI_Aint      displs[],
+             MPI_Datatype        sendtype,
+             void *              recvbuf,
+             MPI_Count           recvcount,
+             MPI_Datatype        recvtype,
+             int                 root,
+             MPI_Comm            comm,
+             CollectiveAlgorithm algorithm)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Scatterv_c");
+    if (algorithm == CollectiveAlgorithm::direct)
+      return Scatterv_c(sendbuf,
+                        sendcounts,
+                        displs,
+                        sendtype,
+                        recvbuf,
+                        recvcount,
+                        recvtype,
+                        root,
+                        comm);
+
+    int myid;
+    int ierr = MPI_Comm_rank(comm, &myid);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    const bool      in_place = (myid == root && recvbuf == MPI_IN_PLACE);
+    const MPI_Count count    = in_place ? 0 : recvcount;
+
+    internal::NodeLayout layout;
+    ierr = internal::setup_node_layout(count, root, comm, layout);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    MPI_Aint lb, recv_extent;
+    ierr = MPI_Type_get_extent(recvtype, &lb, &recv_extent);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    MPI_Comm private_comm;
+    int      tag;
+    ierr = internal::collective_comm(comm, &private_comm, &tag);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    std::vector<char>        packed(layout.node_total * recv_extent);
+    std::vector<MPI_Request> requests;
+    if (layout.node_rank == 0 && layout.node_total > 0)
+      {
+        MPI_Datatype packed_type;
+        ierr = internal::create_packed_type(layout.node_total,
+                                            recvtype,
+                                            &packed_type);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        requests.push_back(MPI_REQUEST_NULL);
+        ierr = Irecv_c(packed.data(),
+                       1,
+                       packed_type,
+                       root,
+                       tag,
+                       private_comm,
+                       &requests.back());
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+        ierr = MPI_Type_free(&packed_type);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+    if (myid == root)
+      for (const auto &node : internal::node_members(layout.leaders))
+        {
+          MPI_Datatype node_type;
+          int          n_blocks;
+          ierr = internal::create_blocks_type(node.second,
+                                              sendcounts,
+                                              displs,
+                                              sendtype,
+                                              in_place ? root : -1,
+                                              &node_type,
+                                              &n_blocks);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+          if (n_blocks == 0)
+            continue;
+
+          requests.push_back(MPI_REQUEST_NULL);
+          ierr = Isend_c(sendbuf,
+                         1,
+                         node_type,
+                         node.first,
+                         tag,
+                         private_comm,
+                         &requests.back());
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+          ierr = MPI_Type_free(&node_type);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+        }
+    ierr = internal::wait_all(requests);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    return Scatterv_c(packed.data(),
+                      layout.node_counts.data(),
+                      layout.node_displs.data(),
+                      recvtype,
+                      in_place ? nullptr : recvbuf,
+                      count,
+                      recvtype,
+                      0,
+                      layout.node);
+  }
+
+  namespace internal
+  {
+    /**
+     * Return the number of processes @p comm receives from and sends to in
+     * neighborhood collectives. Returns MPI_ERR_TOPOLOGY if @p comm has no
+     * topology.
+     */
+    inline int
+    neighbor_counts(MPI_Comm comm, int *indegree, int *outdegree)
+    {
+      int topology;
+      int ierr = MPI_Topo_test(comm, &topology);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      if (topology == MPI_DIST_GRAPH)
+        {
+          int weighted;
+          return MPI_Dist_graph_neighbors_count(
+            comm, indegree, outdegree, &weighted);
+        }
+      else if (topology == MPI_CART)
+        {
+          int n_dims;
+          ierr = MPI_Cartdim_get(comm, &n_dims);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+          *indegree  = 2 * n_dims;
+          *outdegree = 2 * n_dims;
+          return MPI_SUCCESS;
+        }
+      else if (topology == MPI_GRAPH)
+        {
+          int myid;
+          ierr = MPI_Comm_rank(comm, &myid);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+          ierr = MPI_Graph_neighbors_count(comm, myid, indegree);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+          *outdegree = *indegree;
+          return MPI_SUCCESS;
+        }
+
+      return MPI_ERR_TOPOLOGY;
+    }
+
+    /**
+     * Append the arguments of MPI_Neighbor_alltoallw() for @p n blocks of
+     * @p counts elements of @p datatype at @p displs (in units of its
+     * extent) to @p data. Blocks that do not fit into an int are described
+     * by a large datatype, which is added to @p owned_types.
+     */
+    inline int
+    append_alltoallw_arguments(int                        n,
+                               const MPI_Count            counts[],
+                               const MPI_Aint             displs[],
+                               MPI_Datatype               datatype,
+                               RequestData &              data,
+                               std::vector<MPI_Datatype> &owned_types)
+    {
+      MPI_Aint lb, extent;
+      int      ierr = MPI_Type_get_extent(datatype, &lb, &extent);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      for (int i = 0; i < n; ++i)
+        {
+          data.displs.push_back(displs[i] * extent);
+          if (counts[i] <= BigMPICompat::mpi_max_int_count)
+            {
+              data.counts.push_back(counts[i]);
+              data.types.push_back(datatype);
+            }
+          else
+            {
+              MPI_Datatype bigtype;
+              ierr = Type_contiguous_c(counts[i], datatype, &bigtype);
+              if (ierr != MPI_SUCCESS)
+                return ierr;
+              owned_types.push_back(bigtype);
+
+              data.counts.push_back(1);
+              data.types.push_back(bigtype);
+            }
+        }
+      return MPI_SUCCESS;
+    }
+
+    /**
+     * Call MPI_Neighbor_alltoallw() with the send arguments for
+     * @p outdegree neighbors followed by the receive arguments stored in
+     * @p data, or MPI_Ineighbor_alltoallw() if @p request is not nullptr.
+     * In the latter case @p data is kept until the request completes.
+     */
+    inline int
+    neighbor_alltoallw(const void *               sendbuf,
+                       void *                     recvbuf,
+                       int                        outdegree,
+                       RequestData &              data,
+                       std::vector<MPI_Datatype> &owned_types,
+                       MPI_Comm                   comm,
+                       MPI_Request *              request)
+    {
+      int ierr;
+      if (request == nullptr)
+        ierr = MPI_Neighbor_alltoallw(sendbuf,
+                                      data.counts.data(),
+                                      data.displs.data(),
+                                      data.types.data(),
+                                      recvbuf,
+                                      data.counts.data() + outdegree,
+                                      data.displs.data() + outdegree,
+                                      data.types.data() + outdegree,
+                                      comm);
+      else
+        ierr = MPI_Ineighbor_alltoallw(sendbuf,
+                                       data.counts.data(),
+                                       data.displs.data(),
+                                       data.types.data(),
+                                       recvbuf,
+                                       data.counts.data() + outdegree,
+                                       data.displs.data() + outdegree,
+                                       data.types.data() + outdegree,
+                                       comm,
+                                       request);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      // Only the arrays have to stay valid until completion, the types may
+      // be freed right away.
+      for (MPI_Datatype &type : owned_types)
+        {
+          ierr = MPI_Type_free(&type);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+        }
+
+      if (request == nullptr)
+        return MPI_SUCCESS;
+
+      data.release_on_completion = true;
+      request_data()[*request]   = std::move(data);
+      return progress_register(*request);
+    }
+
+    /**
+     * Shared implementation of Neighbor_alltoallv_c() and
+     * Ineighbor_alltoallv_c().
+     */
+    inline int
+    neighbor_alltoallv(const void *    sendbuf,
+                       const MPI_Count sendcounts[],
+                       const MPI_Aint  sdispls[],
+                       MPI_Datatype    sendtype,
+                       void *          recvbuf,
+                       const MPI_Count recvcounts[],
+                       const MPI_Aint  rdispls[],
+                       MPI_Datatype    recvtype,
+                       MPI_Comm        comm,
+                       MPI_Request *   request)
+    {
+      int indegree, outdegree;
+      int ierr = neighbor_counts(comm, &indegree, &outdegree);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      RequestData               data;
+      std::vector<MPI_Datatype> owned_types;
+      ierr = append_alltoallw_arguments(
+        outdegree, sendcounts, sdispls, sendtype, data, owned_types);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      ierr = append_alltoallw_arguments(
+        indegree, recvcounts, rdispls, recvtype, data, owned_types);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      return neighbor_alltoallw(
+        sendbuf, recvbuf, outdegree, data, owned_types, comm, request);
+    }
+
+    /**
+     * Shared implementation of Neighbor_allgatherv_c() and
+     * Ineighbor_allgatherv_c().
+     */
+    inline int
+    neighbor_allgatherv(const void *    sendbuf,
+                        MPI_Count       sendcount,
+                        MPI_Datatype    sendtype,
+                        void *          recvbuf,
+                        const MPI_Count recvcounts[],
+                        const MPI_Aint  displs[],
+                        MPI_Datatype    recvtype,
+                        MPI_Comm        comm,
+                        MPI_Request *   request)
+    {
+      int indegree, outdegree;
+      int ierr = neighbor_counts(comm, &indegree, &outdegree);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      // every neighbor gets the same block, described by a single type
+      RequestData               data;
+      std::vector<MPI_Datatype> owned_types;
+      const MPI_Aint            zero = 0;
+      ierr                           = append_alltoallw_arguments(
+        1, &sendcount, &zero, sendtype, data, owned_types);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      if (outdegree == 0)
+        data = RequestData();
+      else
+        {
+          data.counts.resize(outdegree, data.counts[0]);
+          data.displs.resize(outdegree, data.displs[0]);
+          data.types.resize(outdegree, data.types[0]);
+        }
+
+      ierr = append_alltoallw_arguments(
+        indegree, recvcounts, displs, recvtype, data, owned_types);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      return neighbor_alltoallw(
+        sendbuf, recvbuf, outdegree, data, owned_types, comm, request);
+    }
+  } // namespace internal
+
+  /**
+   * Exchange data with the neighbors in the topology of @p comm, where
+   * the (possibly large) counts and displacements (in units of the extent
+   * of the datatypes) can differ per neighbor.
+   *
+   * Without native support, this calls MPI_Neighbor_alltoallw() with byte
+   * displacements and a large datatype for each block that does not fit
+   * into an int.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Neighbor_alltoallv_c(const void *    sendbuf,
+                       const MPI_Count sendcounts[],
+                       const MPI_Aint  sdispls[],
+                       MPI_Datatype    sendtype,
+                       void *          recvbuf,
+                       const MPI_Count recvcounts[],
+                       const MPI_Aint  rdispls[],
+                       MPI_Datatype    recvtype,
+                       MPI_Comm        comm)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Neighbor_alltoallv_c");
+#if MPI_VERSION >= 4
+    return MPI_Neighbor_alltoallv_c(sendbuf,
+                                    sendcounts,
+                                    sdispls,
+                                    sendtype,
+                                    recvbuf,
+                                    recvcounts,
+                                    rdispls,
+                                    recvtype,
+                                    comm);
+#else
+    return internal::neighbor_alltoallv(sendbuf,
+                                        sendcounts,
+                                        sdispls,
+                                        sendtype,
+                                        recvbuf,
+                                        recvcounts,
+                                        rdispls,
+                                        recvtype,
+                                        comm,
+                                        nullptr);
+#endif
+  }
+
+  /**
+   * Nonblocking version of Neighbor_alltoallv_c(). The request has to be
+   * completed with BigMPICompat::Test() or BigMPICompat::Wait().
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Ineighbor_alltoallv_c(const void *    sendbuf,
+                        const MPI_Count sendcounts[],
+                        const MPI_Aint  sdispls[],
+                        MPI_Datatype    sendtype,
+                        void *          recvbuf,
+                        const MPI_Count recvcounts[],
+                        const MPI_Aint  rdispls[],
+                        MPI_Datatype    recvtype,
+                        MPI_Comm        comm,
+                        MPI_Request *   request)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Ineighbor_alltoallv_c");
+#if MPI_VERSION >= 4
+    const int ierr = MPI_Ineighbor_alltoallv_c(sendbuf,
+                                               sendcounts,
+                                               sdispls,
+                                               sendtype,
+                                               recvbuf,
+                                               recvcounts,
+                                               rdispls,
+                                               recvtype,
+                                               comm,
+                                               request);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    return internal::progress_register(*request);
+#else
+    return internal::neighbor_alltoallv(sendbuf,
+                                        sendcounts,
+                                        sdispls,
+                                        sendtype,
+                                        recvbuf,
+                                        recvcounts,
+                                        rdispls,
+                                        recvtype,
+                                        comm,
+                                        request);
+#endif
+  }
+
+  /**
+   * Send the same (possibly large) @p sendcount to all neighbors in the
+   * topology of @p comm and receive @p recvcounts[i] from neighbor i at
+   * @p displs[i] (in units of the extent of @p recvtype).
+   *
+   * Without native support, this calls MPI_Neighbor_alltoallw() like
+   * Neighbor_alltoallv_c().
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Neighbor_allgatherv_c(const void *    sendbuf,
+                        MPI_Count       sendcount,
+                        MPI_Datatype    sendtype,
+                        void *          recvbuf,
+                        const MPI_Count recvcounts[],
+                        const MPI_Aint  displs[],
+                        MPI_Datatype    recvtype,
+                        MPI_Comm        comm)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Neighbor_allgatherv_c");
+#if MPI_VERSION >= 4
+    return MPI_Neighbor_allgatherv_c(sendbuf,
+                                     sendcount,
+                                     sendtype,
+                                     recvbuf,
+                                     recvcounts,
+                                     displs,
+                                     recvtype,
+                                     comm);
+#else
+    return internal::neighbor_allgatherv(sendbuf,
+                                         sendcount,
+                                         sendtype,
+                                         recvbuf,
+                                         recvcounts,
+                                         displs,
+                                         recvtype,
+                                         comm,
+                                         nullptr);
+#endif
+  }
+
+  /**
+   * Nonblocking version of Neighbor_allgatherv_c(). The request has to be
+   * completed with BigMPICompat::Test() or BigMPICompat::Wait().
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Ineighbor_allgatherv_c(const void *    sendbuf,
+                         MPI_Count       sendcount,
+                         MPI_Datatype    sendtype,
+                         void *          recvbuf,
+                         const MPI_Count recvcounts[],
+                         const MPI_Aint  displs[],
+                         MPI_Datatype    recvtype,
+                         MPI_Comm        comm,
+                         MPI_Request *   request)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Ineighbor_allgatherv_c");
+#if MPI_VERSION >= 4
+    const int ierr = MPI_Ineighbor_allgatherv_c(sendbuf,
+                                                sendcount,
+                                                sendtype,
+                                                recvbuf,
+                                                recvcounts,
+                                                displs,
+                                                recvtype,
+                                                comm,
+                                                request);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    return internal::progress_register(*request);
+#else
+    return internal::neighbor_allgatherv(sendbuf,
+                                         sendcount,
+                                         sendtype,
+                                         recvbuf,
+                                         recvcounts,
+                                         displs,
+                                         recvtype,
+                                         comm,
+                                         request);
+#endif
+  }
+
+  /**
+   * The large message algorithms of Allgather_c() and Iallgather_c() send
+   * the blocks of the processes in contiguous segments of at most this
+   * many bytes, so that every message is a plain chunk of the receive
+   * buffer and the segments of a ring can be pipelined.
+   */
+  static constexpr MPI_Count allgather_segment_bytes =
+    (BigMPICompat::mpi_max_int_count < (1 << 24)) ?
+      BigMPICompat::mpi_max_int_count :
+      (1 << 24);
+
+  namespace internal
+  {
+    /**
+     * Call MPI_Allgather(), or MPI_Iallgather() if @p request is not
+     * nullptr, for a @p recvcount that fits into an int on all processes.
+     * A larger @p sendcount is sent as a single large datatype.
+     */
+    inline int
+    allgather_int(const void * sendbuf,
+                  MPI_Count    sendcount,
+                  MPI_Datatype sendtype,
+                  void *       recvbuf,
+                  MPI_Count    recvcount,
+                  MPI_Datatype recvtype,
+                  MPI_Comm     comm,
+                  MPI_Request *request)
+    {
+      int          ierr;
+      MPI_Datatype bigtype = MPI_DATATYPE_NULL;
+      if (sendcount > BigMPICompat::mpi_max_int_count &&
+          sendbuf != MPI_IN_PLACE)
+        {
+          ierr = Type_contiguous_c(sendcount, sendtype, &bigtype);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+          sendcount = 1;
+          sendtype  = bigtype;
+        }
+
+      if (request == nullptr)
+        ierr = MPI_Allgather(sendbuf,
+                             sendcount,
+                             sendtype,
+                             recvbuf,
+                             recvcount,
+                             recvtype,
+                             comm);
+      else
+        ierr = MPI_Iallgather(sendbuf,
+                              sendcount,
+                              sendtype,
+                              recvbuf,
+                              recvcount,
+                              recvtype,
+                              comm,
+                              request);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      if (bigtype != MPI_DATATYPE_NULL)
+        {
+          ierr = MPI_Type_free(&bigtype);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+        }
+      if (request != nullptr)
+        return progress_register(*request);
+      return MPI_SUCCESS;
+    }
+
+    /**
+     * Copy the block of this process from @p sendbuf into its place in
+     * @p recvbuf, unless the operation is in place, with a message with
+     * @p tag on @p private_comm.
+     */
+    inline int
+    allgather_copy_own_block(const void * sendbuf,
+                             MPI_Count    sendcount,
+                             MPI_Datatype sendtype,
+                             void *       recvbuf,
+                             MPI_Count    recvcount,
+                             MPI_Datatype recvtype,
+                             MPI_Comm     private_comm,
+                             int          tag)
+    {
+      if (sendbuf == MPI_IN_PLACE)
+        return MPI_SUCCESS;
+
+      int myid;
+      int ierr = MPI_Comm_rank(private_comm, &myid);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      MPI_Aint lb, extent;
+      ierr = MPI_Type_get_extent(recvtype, &lb, &extent);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      std::vector<MPI_Request> requests(2, MPI_REQUEST_NULL);
+      ierr = Irecv_c(static_cast<char *>(recvbuf) + myid * recvcount * extent,
+                     recvcount,
+                     recvtype,
+                     myid,
+                     tag,
+                     private_comm,
+                     &requests[0]);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      ierr = Isend_c(
+        sendbuf, sendcount, sendtype, myid, tag, private_comm, &requests[1]);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      return wait_all(requests);
+    }
+
+    /**
+     * Compute the number of elements of @p recvtype in one segment of at
+     * most allgather_segment_bytes and the extent of @p recvtype.
+     */
+    inline int
+    allgather_segment(MPI_Datatype recvtype,
+                      MPI_Count *  segment,
+                      MPI_Aint *   extent)
+    {
+      MPI_Aint  lb;
+      const int ierr = MPI_Type_get_extent(recvtype, &lb, extent);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      *segment = std::max<MPI_Count>(
+        1, allgather_segment_bytes / std::max<MPI_Aint>(*extent, 1));
+      return MPI_SUCCESS;
+    }
+  } // namespace internal
+
+  /**
+   * Gather a (possibly large) @p sendcount from every process into
+   * @p recvbuf on all processes, where the data of process i is stored
+   * at offset i * @p recvcount (in units of the extent of @p recvtype).
+   *
+   * Without native support, MPI_Allgather() is used if the whole receive
+   * buffer fits into an int count. Otherwise the blocks travel around a
+   * ring in segments of allgather_segment_bytes: in step s, every process
+   * forwards to its right neighbor the block it received in step s-1, one
+   * segment at a time as soon as that segment arrived. Every process sends
+   * and receives (p-1)/p of the result, which is bandwidth optimal, and
+   * all messages are contiguous parts of @p recvbuf.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Allgather_c(const void * sendbuf,
+              MPI_Count    sendcount,
+              MPI_Datatype sendtype,
+              void *       recvbuf,
+              MPI_Count    recvcount,
+              MPI_Datatype recvtype,
+              MPI_Comm     comm)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Allgather_c");
+#if MPI_VERSION >= 4
+    return MPI_Allgather_c(
+      sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+#else
+    int n_ranks, myid;
+    int ierr = MPI_Comm_size(comm, &n_ranks);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = MPI_Comm_rank(comm, &myid);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    // recvcount is the same on all processes, so this decision is, too
+    if (recvcount * n_ranks <= BigMPICompat::mpi_max_int_count)
+      return internal::allgather_int(sendbuf,
+                                     sendcount,
+                                     sendtype,
+                                     recvbuf,
+                                     recvcount,
+                                     recvtype,
+                                     comm,
+                                     nullptr);
+
+    MPI_Comm private_comm;
+    int      tag;
+    ierr = internal::collective_comm(comm, &private_comm, &tag);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = internal::allgather_copy_own_block(sendbuf,
+                                              sendcount,
+                                              sendtype,
+                                              recvbuf,
+                                              recvcount,
+                                              recvtype,
+                                              private_comm,
+                                              tag);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    MPI_Count segment;
+    MPI_Aint  extent;
+    ierr = internal::allgather_segment(recvtype, &segment, &extent);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    char *          data       = static_cast<char *>(recvbuf);
+    const int       right      = (myid + 1) % n_ranks;
+    const int       left       = (myid + n_ranks - 1) % n_ranks;
+    const MPI_Count n_segments = (recvcount + segment - 1) / segment;
+
+    // receives[k] is the receive of segment k in the current step, which is
+    // forwarded in the next one. The sends of a step are completed after
+    // the sends of the following step have been started.
+    std::vector<MPI_Request> receives(n_segments, MPI_REQUEST_NULL);
+    std::vector<MPI_Request> sends, previous_sends;
+    for (int step = 0; step < n_ranks - 1; ++step)
+      {
+        MPI_COMPAT_TRACE_SCOPE("ring step");
+        const MPI_Count send_block = (myid + n_ranks - step) % n_ranks;
+        const MPI_Count recv_block = (myid + n_ranks - step - 1) % n_ranks;
+        for (MPI_Count k = 0; k < n_segments; ++k)
+          {
+            const MPI_Count first = k * segment;
+            const MPI_Count count = std::min(segment, recvcount - first);
+
+            ierr = Wait(&receives[k], MPI_STATUS_IGNORE);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+            ierr = Irecv_c(data + (recv_block * recvcount + first) * extent,
+                           count,
+                           recvtype,
+                           left,
+                           tag,
+                           private_comm,
+                           &receives[k]);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+
+            sends.push_back(MPI_REQUEST_NULL);
+            ierr = Isend_c(data + (send_block * recvcount + first) * extent,
+                           count,
+                           recvtype,
+                           right,
+                           tag,
+                           private_comm,
+                           &sends.back());
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+
+        ierr = internal::wait_all(previous_sends);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+        previous_sends.swap(sends);
+      }
+
+    ierr = internal::wait_all(receives);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    return internal::wait_all(previous_sends);
+#endif
+  }
+
+  /**
+   * Nonblocking version of Allgather_c(). The request has to be completed
+   * with BigMPICompat::Test() or BigMPICompat::Wait().
+   *
+   * Without native support and for a receive buffer that does not fit
+   * into an int count, the block of this process is copied into place
+   * before this function returns, and the first step of the ring of
+   * Allgather_c() is posted. Each further step of a segment is posted once
+   * the previous step of that segment completed, by BigMPICompat::Test(),
+   * BigMPICompat::Wait() or the progress thread (see Progress_start()), so
+   * at most one receive and one send per segment are in flight. Test() and
+   * Wait() on one such request advance all others as well, and every
+   * operation has its own tag, so several of them may be outstanding on
+   * the same communicator and be completed in any order.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Iallgather_c(const void * sendbuf,
+               MPI_Count    sendcount,
+               MPI_Datatype sendtype,
+               void *       recvbuf,
+               MPI_Count    recvcount,
+               MPI_Datatype recvtype,
+               MPI_Comm     comm,
+               MPI_Request *request)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Iallgather_c");
+#if MPI_VERSION >= 4
+    const int ierr = MPI_Iallgather_c(sendbuf,
+                                      sendcount,
+                                      sendtype,
+                                      recvbuf,
+                                      recvcount,
+                                      recvtype,
+                                      comm,
+                                      request);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    return internal::progress_register(*request);
+#else
+    int n_ranks, myid;
+    int ierr = MPI_Comm_size(comm, &n_ranks);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = MPI_Comm_rank(comm, &myid);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    if (recvcount * n_ranks <= BigMPICompat::mpi_max_int_count)
+      return internal::allgather_int(sendbuf,
+                                     sendcount,
+                                     sendtype,
+                                     recvbuf,
+                                     recvcount,
+                                     recvtype,
+                                     comm,
+                                     request);
+
+    MPI_Comm private_comm;
+    int      tag;
+    ierr = internal::collective_comm(comm, &private_comm, &tag);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = internal::allgather_copy_own_block(sendbuf,
+                                              sendcount,
+                                              sendtype,
+                                              recvbuf,
+                                              recvcount,
+                                              recvtype,
+                                              private_comm,
+                                              tag);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    MPI_Count segment;
+    MPI_Aint  extent;
+    ierr = internal::allgather_segment(recvtype, &segment, &extent);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    // inactive placeholder for the user, see RequestData::ring
+    ierr = MPI_Recv_init(
+      nullptr, 0, MPI_BYTE, MPI_PROC_NULL, 0, MPI_COMM_SELF, request);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    auto ring        = std::make_shared<internal::AllgatherRing>();
+    ring->data       = static_cast<char *>(recvbuf);
+    ring->recvcount  = recvcount;
+    ring->recvtype   = recvtype;
+    ring->extent     = extent;
+    ring->segment    = segment;
+    ring->n_segments = (recvcount + segment - 1) / segment;
+    ring->myid       = myid;
+    ring->n_ranks    = n_ranks;
+    ring->comm       = private_comm;
+    ring->tag        = tag;
+    ring->receives.resize(ring->n_segments, MPI_REQUEST_NULL);
+    ring->sends.resize(ring->n_segments, MPI_REQUEST_NULL);
+    internal::request_data()[*request].ring = ring;
+
+    // post the first step, the others follow in Test(), Wait() and the
+    // progress thread
+    int done;
+    ierr = internal::advance_allgather_ring(*ring, &done);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    internal::progress_register(ring);
+    return MPI_SUCCESS;
+#endif
+  }
+
+  /**
+   * Interface of the codecs used by Send_compressed_c(),
+   * Recv_compressed_c(), File_write_at_compressed_c() and
+   * File_read_at_compressed_c() to compress each chunk of the data.
+   * The functions of a codec may be called from several threads at once,
+   * each with its own scratch memory.
+   */
+  class Codec
+  {
+  public:
+    virtual ~Codec() = default;
+
+    /**
+     * Return an upper bound for the compressed size of @p n_bytes.
+     */
+    virtual std::size_t
+    max_compressed_size(std::size_t n_bytes) const = 0;
+
+    /**
+     * Return the number of bytes of scratch memory compress() and
+     * decompress() need for chunks of up to @p n_bytes. The transfers
+     * allocate it once and reuse it for all chunks.
+     */
+    virtual std::size_t
+    scratch_size(std::size_t n_bytes) const
+    {
+      (void)n_bytes;
+      return 0;
+    }
+
+    /**
+     * Compress the @p n_bytes at @p in into @p out, which has room for
+     * max_compressed_size() bytes, and return the compressed size.
+     * @p scratch points to scratch_size() bytes, aligned for any type.
+     */
+    virtual std::size_t
+    compress(const char *in,
+             std::size_t n_bytes,
+             char *      out,
+             void *      scratch) const = 0;
+
+    /**
+     * Restore the @p n_bytes of @p out from the @p n_compressed bytes at
+     * @p in, using the scratch memory @p scratch. Returns false if the
+     * compressed data is corrupt.
+     */
+    virtual bool
+    decompress(const char *in,
+               std::size_t n_compressed,
+               char *      out,
+               std::size_t n_bytes,
+               void *      scratch) const = 0;
+
+    /**
+     * Like compress() above, with scratch memory allocated just for this
+     * call.
+     */
+    std::size_t
+    compress(const char *in, std::size_t n_bytes, char *out) const
+    {
+      std::vector<std::max_align_t> scratch(
+        (scratch_size(n_bytes) + sizeof(std::max_align_t) - 1) /
+        sizeof(std::max_align_t));
+      return compress(in, n_bytes, out, scratch.data());
+    }
+
+    /**
+     * Like decompress() above, with scratch memory allocated just for this
+     * call.
+     */
+    bool
+    decompress(const char *in,
+               std::size_t n_compressed,
+               char *      out,
+               std::size_t n_bytes) const
+    {
+      std::vector<std::max_align_t> scratch(
+        (scratch_size(n_bytes) + sizeof(std::max_align_t) - 1) /
+        sizeof(std::max_align_t));
+      return decompress(in, n_compressed, out, n_bytes, scratch.data());
+    }
+  };
+
+  namespace internal
+  {
+    /**
+     * Append the remainder @p value of a length in the LZ format of
+     * ShuffleLZCodec: a sequence of bytes 255 followed by a smaller byte.
+     */
+    inline void
+    lz_write_length(unsigned char *out, std::size_t &pos, std::size_t value)
+    {
+      for (; value >= 255; value -= 255)
+        out[pos++] = 255;
+      out[pos++] = value;
+    }
+
+    /**
+     * Read a length written by lz_write_length() and add it to @p value.
+     * Returns false at the end of the input.
+     */
+    inline bool
+    lz_read_length(const unsigned char *in,
+                   std::size_t          n_in,
+                   std::size_t &        pos,
+                   std::size_t &        value)
+    {
+      unsigned char byte;
+      do
+        {
+          if (pos >= n_in)
+            return false;
+          byte = in[pos++];
+          value += byte;
+        }
+      while (byte == 255);
+      return true;
+    }
+
+    /**
+     * Number of bits of the hashes lz_compress() uses to find matches.
+     */
+    static constexpr unsigned int lz_hash_bits = 16;
+
+    /**
+     * Compress @p n bytes with a greedy LZ77 scheme in the sequence format
+     * of LZ4: a token with the lengths of the literals and of the match,
+     * the literals, and a 16 bit offset of the match. The last sequence
+     * has no match. Returns 0 if the output would not fit into
+     * @p capacity bytes. @p table is scratch memory for 2^lz_hash_bits
+     * positions.
+     *
+     * Like LZ4, the search skips ahead faster the longer it finds no
+     * match (one more byte per step after every 64 misses), so data that
+     * does not compress is scanned quickly and then stored as is.
+     */
+    inline std::size_t
+    lz_compress(const unsigned char *in,
+                std::size_t          n,
+                unsigned char *      out,
+                std::size_t          capacity,
+                std::uint32_t *      table)
+    {
+      const std::size_t  min_match    = 4;
+      const unsigned int skip_trigger = 6;
+      std::fill(table, table + (1u << lz_hash_bits), 0);
+
+      std::size_t pos = 0, anchor = 0, o = 0, misses = 0;
+      while (pos + min_match <= n)
+        {
+          std::uint32_t sequence;
+          std::memcpy(&sequence, in + pos, sizeof(sequence));
+          const std::uint32_t hash =
+            (sequence * 2654435761u) >> (32 - lz_hash_bits);
+          const std::size_t candidate = table[hash];
+          table[hash] = pos + 1;
+
+          // positions are stored plus one, so that zero means empty
+          if (candidate == 0 || pos - (candidate - 1) > 65535 ||
+              std::memcmp(in + candidate - 1, in + pos, min_match) != 0)
+            {
+              pos += 1 + (misses++ >> skip_trigger);
+              continue;
+            }
+          misses = 0;
+
+          const std::size_t match = candidate - 1;
+          std::size_t       length = min_match;
+          while (pos + length < n && in[match + length] == in[pos + length])
+            ++length;
+
+          const std::size_t literals = pos - anchor;
+          if (o + literals + literals / 255 + length / 255 + 6 > capacity)
+            return 0;
+
+          out[o++] = (std::min<std::size_t>(literals, 15) << 4) |
+                     std::min<std::size_t>(length - min_match, 15);
+          if (literals >= 15)
+            lz_write_length(out, o, literals - 15);
+          std::memcpy(out + o, in + anchor, literals);
+          o += literals;
+          out[o++] = (pos - match) & 0xff;
+          out[o++] = (pos - match) >> 8;
+          if (length - min_match >= 15)
+            lz_write_length(out, o, length - min_match - 15);
+
+          pos += length;
+          anchor = pos;
+        }
+
+      const std::size_t literals = n - anchor;
+      if (o + literals + literals / 255 + 2 > capacity)
+        return 0;
+      out[o++] = std::min<std::size_t>(literals, 15) << 4;
+      if (literals >= 15)
+        lz_write_length(out, o, literals - 15);
+      std::memcpy(out + o, in + anchor, literals);
+      return o + literals;
+    }
+
+    /**
+     * Decompress the output of lz_compress(). Returns false unless the
+     * input is valid and restores exactly @p n bytes.
+     */
+    inline bool
+    lz_decompress(const unsigned char *in,
+                  std::size_t          n_in,
+                  unsigned char *      out,
+                  std::size_t          n)
+    {
+      std::size_t i = 0, o = 0;
+      while (true)
+        {
+          if (i >= n_in)
+            return false;
+          const unsigned char token = in[i++];
+
+          std::size_t literals = token >> 4;
+          if (literals == 15 && !lz_read_length(in, n_in, i, literals))
+            return false;
+          if (literals > n_in - i || literals > n - o)
+            return false;
+          std::memcpy(out + o, in + i, literals);
+          i += literals;
+          o += literals;
+
+          if (i == n_in)
+            return o == n;
+
+          if (n_in - i < 2)
+            return false;
+          const std::size_t offset = in[i] | (in[i + 1] << 8);
+          i += 2;
+          std::size_t length = token & 15;
+          if (length == 15 && !lz_read_length(in, n_in, i, length))
+            return false;
+          length += 4;
+          if (offset == 0 || offset > o || length > n - o)
+            return false;
+
+          // the match may overlap the bytes it produces
+          for (std::size_t k = 0; k < length; ++k, ++o)
+            out[o] = out[o - offset];
+        }
+    }
+  } // namespace internal
+
+  /**
+   * The built-in codec: the bytes of the elements are first regrouped by
+   * their position in the element (byte shuffle), which makes the slowly
+   * varying high bytes of integer and floating point arrays compress well,
+   * and then compressed with a fast LZ77 scheme. Data that does not
+   * compress is stored as is, so the output is at most one byte larger
+   * than the input.
+   */
+  class ShuffleLZCodec : public Codec
+  {
+  public:
+    /**
+     * Create a codec for elements of @p element_size bytes.
+     */
+    explicit ShuffleLZCodec(const std::size_t element_size = 1)
+      : element_size(std::max<std::size_t>(element_size, 1))
+    {}
+
+    using Codec::compress;
+    using Codec::decompress;
+
+    virtual std::size_t
+    max_compressed_size(std::size_t n_bytes) const override
+    {
+      return n_bytes + 1;
+    }
+
+    /**
+     * The hash table of the LZ77 search followed by room for the shuffled
+     * bytes.
+     */
+    virtual std::size_t
+    scratch_size(std::size_t n_bytes) const override
+    {
+      return sizeof(std::uint32_t) * (1u << internal::lz_hash_bits) +
+             ((element_size > 1) ? n_bytes : 0);
+    }
+
+    virtual std::size_t
+    compress(const char *in,
+             std::size_t n_bytes,
+             char *      out,
+             void *      scratch) const override
+    {
+      const unsigned char *bytes = reinterpret_cast<const unsigned char *>(in);
+      unsigned char *      result = reinterpret_cast<unsigned char *>(out);
+      std::uint32_t *      table  = static_cast<std::uint32_t *>(scratch);
+      unsigned char *      shuffled = reinterpret_cast<unsigned char *>(
+        table + (1u << internal::lz_hash_bits));
+
+      if (element_size > 1)
+        {
+          shuffle(bytes, n_bytes, shuffled);
+          bytes = shuffled;
+        }
+
+      const std::size_t size =
+        (n_bytes > 1) ?
+          internal::lz_compress(
+            bytes, n_bytes, result + 1, n_bytes - 1, table) :
+          0;
+      if (size == 0)
+        {
+          result[0] = stored;
+          std::memcpy(result + 1, in, n_bytes);
+          return n_bytes + 1;
+        }
+      result[0] = compressed;
+      return size + 1;
+    }
+
+    virtual bool
+    decompress(const char *in,
+               std::size_t n_compressed,
+               char *      out,
+               std::size_t n_bytes,
+               void *      scratch) const override
+    {
+      const unsigned char *bytes = reinterpret_cast<const unsigned char *>(in);
+      unsigned char *      result = reinterpret_cast<unsigned char *>(out);
+
+      if (n_compressed == 0)
+        return false;
+      if (bytes[0] == stored)
+        {
+          if (n_compressed != n_bytes + 1)
+            return false;
+          std::memcpy(result, bytes + 1, n_bytes);
+          return true;
+        }
+      if (bytes[0] != compressed)
+        return false;
+
+      if (element_size == 1)
+        return internal::lz_decompress(bytes + 1,
+                                       n_compressed - 1,
+                                       result,
+                                       n_bytes);
+
+      unsigned char *shuffled = reinterpret_cast<unsigned char *>(
+        static_cast<std::uint32_t *>(scratch) +
+        (1u << internal::lz_hash_bits));
+      if (!internal::lz_decompress(bytes + 1,
+                                   n_compressed - 1,
+                                   shuffled,
+                                   n_bytes))
+        return false;
+      unshuffle(shuffled, n_bytes, result);
+      return true;
+    }
+
+  private:
+    static constexpr unsigned char stored     = 0;
+    static constexpr unsigned char compressed = 1;
+
+    /**
+     * Store byte b of element i at b * n_elements + i. Trailing bytes
+     * that do not form a whole element are copied unchanged.
+     */
+    void
+    shuffle(const unsigned char *in, std::size_t n_bytes, unsigned char *out)
+      const
+    {
+      const std::size_t n_elements = n_bytes / element_size;
+      for (std::size_t i = 0; i < n_elements; ++i)
+        for (std::size_t b = 0; b < element_size; ++b)
+          out[b * n_elements + i] = in[i * element_size + b];
+      std::memcpy(out + n_elements * element_size,
+                  in + n_elements * element_size,
+                  n_bytes - n_elements * element_size);
+    }
+
+    /**
+     * Inverse of shuffle().
+     */
+    void
+    unshuffle(const unsigned char *in, std::size_t n_bytes, unsigned char *out)
+      const
+    {
+      const std::size_t n_elements = n_bytes / element_size;
+      for (std::size_t i = 0; i < n_elements; ++i)
+        for (std::size_t b = 0; b < element_size; ++b)
+          out[i * element_size + b] = in[b * n_elements + i];
+      std::memcpy(out + n_elements * element_size,
+                  in + n_elements * element_size,
+                  n_bytes - n_elements * element_size);
+    }
+
+    std::size_t element_size;
+  };
+
+  /**
+   * The transfers with compression below split the data into chunks of
+   * this many bytes and compress each chunk separately.
+   */
+  static constexpr MPI_Count compression_chunk_bytes =
+    (BigMPICompat::mpi_max_int_count < (1 << 24)) ?
+      BigMPICompat::mpi_max_int_count :
+      (1 << 24);
+
+  namespace internal
+  {
+    /**
+     * Return the number of compression chunks of @p chunk_bytes for
+     * @p n_bytes. There is always at least one, so that also empty
+     * messages are sent.
+     */
+    inline MPI_Count
+    n_compression_chunks(MPI_Count n_bytes,
+                         MPI_Count chunk_bytes = compression_chunk_bytes)
+    {
+      return std::max<MPI_Count>(1,
+                                 (n_bytes + chunk_bytes - 1) / chunk_bytes);
+    }
+
+    /**
+     * Return the size of the compression chunk @p chunk of @p n_bytes.
+     */
+    inline std::size_t
+    compression_chunk_size(MPI_Count n_bytes,
+                           MPI_Count chunk,
+                           MPI_Count chunk_bytes = compression_chunk_bytes)
+    {
+      return std::min(chunk_bytes, n_bytes - chunk * chunk_bytes);
+    }
+
+    /**
+     * Buffers of a transfer with compression, allocated once and reused
+     * for all chunks: two buffers for compressed chunks and the scratch
+     * memory of the codec.
+     */
+    struct CompressionBuffers
+    {
+      std::vector<std::vector<char>> staging;
+      std::vector<std::max_align_t>  scratch;
+    };
+
+    /**
+     * Check that @p datatype is contiguous, compute the size of the data
+     * in @p n_bytes and allocate @p buffers for chunks of @p chunk_bytes.
+     * If @p codec is nullptr, @p default_codec is set up as ShuffleLZCodec
+     * for the elements of @p datatype and returned in @p used.
+     */
+    inline int
+    setup_compression(MPI_Count           count,
+                      MPI_Datatype        datatype,
+                      const Codec *       codec,
+                      ShuffleLZCodec &    default_codec,
+                      const Codec *&      used,
+                      MPI_Count *         n_bytes,
+                      CompressionBuffers &buffers,
+                      MPI_Count chunk_bytes = compression_chunk_bytes)
+    {
+      int ierr = contiguous_bytes(count, datatype, n_bytes);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      int element_size;
+      ierr = MPI_Type_size(datatype, &element_size);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      default_codec = ShuffleLZCodec(element_size);
+      used          = (codec != nullptr) ? codec : &default_codec;
+
+      const std::size_t capacity = used->max_compressed_size(chunk_bytes);
+      if (capacity > static_cast<std::size_t>(std::numeric_limits<int>::max()))
+        return MPI_ERR_COUNT;
+      buffers.staging.assign(2, std::vector<char>(capacity));
+      buffers.scratch.resize(
+        (used->scratch_size(chunk_bytes) + sizeof(std::max_align_t) - 1) /
+        sizeof(std::max_align_t));
+      return MPI_SUCCESS;
+    }
+  } // namespace internal
+
+  /**
+   * Like Send_c(), but every chunk of compression_chunk_bytes is
+   * compressed with @p codec (ShuffleLZCodec for the elements of
+   * @p datatype if nullptr) and sent as one message. The next chunk is
+   * compressed while the previous one is being sent. Receive the data
+   * with Recv_compressed_c() and the same codec.
+   *
+   * The datatype has to be contiguous and the receiver must use the same
+   * @p count.
+   */
+  inline int
+  Send_compressed_c(const void *  buf,
+                    MPI_Count     count,
+                    MPI_Datatype  datatype,
+                    int           dest,
+                    int           tag,
+                    MPI_Comm      comm,
+                    const Codec * codec = nullptr)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Send_compressed_c");
+    ShuffleLZCodec               default_codec;
+    const Codec *                used;
+    MPI_Count                    n_bytes;
+    internal::CompressionBuffers buffers;
+    int                          ierr = internal::setup_compression(
+      count, datatype, codec, default_codec, used, &n_bytes, buffers);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    std::vector<std::vector<char>> &staging = buffers.staging;
+
+    const MPI_Count n_chunks    = internal::n_compression_chunks(n_bytes);
+    MPI_Request     requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+
+    for (MPI_Count chunk = 0; chunk < n_chunks; ++chunk)
+      {
+        MPI_COMPAT_TRACE_SCOPE("chunk");
+        ierr = MPI_Wait(&requests[chunk % 2], MPI_STATUS_IGNORE);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        const std::size_t size =
+          used->compress(static_cast<const char *>(buf) +
+                           chunk * compression_chunk_bytes,
+                         internal::compression_chunk_size(n_bytes, chunk),
+                         staging[chunk % 2].data(),
+                         buffers.scratch.data());
+        ierr = MPI_Isend(staging[chunk % 2].data(),
+                         size,
+                         MPI_BYTE,
+                         dest,
+                         tag,
+                         comm,
+                         &requests[chunk % 2]);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+    return MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+  }
+
+  /**
+   * Receive data sent by Send_compressed_c(). Every chunk is decompressed
+   * while the next one is still being received. Returns MPI_ERR_OTHER if
+   * @p codec can not restore a chunk.
+   *
+   * The datatype has to be contiguous and the sender must use the same
+   * @p count.
+   */
+  inline int
+  Recv_compressed_c(void *        buf,
+                    MPI_Count     count,
+                    MPI_Datatype  datatype,
+                    int           source,
+                    int           tag,
+                    MPI_Comm      comm,
+                    MPI_Status *  status,
+                    const Codec * codec = nullptr)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Recv_compressed_c");
+    ShuffleLZCodec               default_codec;
+    const Codec *                used;
+    MPI_Count                    n_bytes;
+    internal::CompressionBuffers buffers;
+    int                          ierr = internal::setup_compression(
+      count, datatype, codec, default_codec, used, &n_bytes, buffers);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    std::vector<std::vector<char>> &staging = buffers.staging;
+
+    const MPI_Count n_chunks    = internal::n_compression_chunks(n_bytes);
+    MPI_Request     requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    MPI_Status      first_status;
+    bool            corrupt = false;
+
+    // All chunks have to come from the same message stream, so receive the
+    // first one before posting the others if wildcards are used.
+    for (MPI_Count chunk = 0; chunk < std::min<MPI_Count>(n_chunks, 2);
+         ++chunk)
+      {
+        if (chunk == 0 && (source == MPI_ANY_SOURCE || tag == MPI_ANY_TAG))
+          {
+            ierr = MPI_Probe(source, tag, comm, &first_status);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+            source = first_status.MPI_SOURCE;
+            tag    = first_status.MPI_TAG;
+          }
+        ierr = MPI_Irecv(staging[chunk].data(),
+                         staging[chunk].size(),
+                         MPI_BYTE,
+                         source,
+                         tag,
+                         comm,
+                         &requests[chunk]);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+
+    char *data = static_cast<char *>(buf);
+    for (MPI_Count chunk = 0; chunk < n_chunks; ++chunk)
+      {
+        MPI_COMPAT_TRACE_SCOPE("chunk");
+        MPI_Status chunk_status;
+        ierr = MPI_Wait(&requests[chunk % 2], &chunk_status);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+        if (chunk == 0)
+          first_status = chunk_status;
+
+        int size;
+        ierr = MPI_Get_count(&chunk_status, MPI_BYTE, &size);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+        if (!used->decompress(staging[chunk % 2].data(),
+                              size,
+                              data + chunk * compression_chunk_bytes,
+                              internal::compression_chunk_size(n_bytes,
+                                                               chunk),
+                              buffers.scratch.data()))
+          corrupt = true;
+
+        if (chunk + 2 < n_chunks)
+          {
+            ierr = MPI_Irecv(staging[chunk % 2].data(),
+                             staging[chunk % 2].size(),
+                             MPI_BYTE,
+                             source,
+                             tag,
+                             comm,
+                             &requests[chunk % 2]);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+          }
+      }
+
+    if (status != MPI_STATUS_IGNORE)
+      {
+        *status = first_status;
+        ierr    = MPI_Status_set_elements_x(status, datatype, count);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+    return corrupt ? MPI_ERR_OTHER : MPI_SUCCESS;
+  }
+
+  /**
+   * Like File_write_at_c(), but every chunk of compression_chunk_bytes is
+   * compressed with @p codec (ShuffleLZCodec for the elements of
+   * @p datatype if nullptr). The next chunk is compressed while the
+   * previous one is being written.
+   *
+   * The file is self-describing: at @p offset, a header of 64 bit words
+   * (MPI_UINT64_T in native representation) holds the uncompressed size in
+   * bytes, the chunk size and the compressed size of every chunk, and the
+   * compressed chunks follow one after the other. The total number of
+   * bytes written is returned in @p extent unless it is nullptr.
+   *
+   * The datatype has to be contiguous and the file view has to use MPI_BYTE
+   * as elementary type, like the default view.
+   */
+  inline int
+  File_write_at_compressed_c(MPI_File      fh,
+                             MPI_Offset    offset,
+                             const void *  buf,
+                             MPI_Count     count,
+                             MPI_Datatype  datatype,
+                             MPI_Status *  status,
+                             MPI_Offset *  extent = nullptr,
+                             const Codec * codec  = nullptr)
+  {
+    MPI_COMPAT_TRACE_SCOPE("File_write_at_compressed_c");
+    ShuffleLZCodec               default_codec;
+    const Codec *                used;
+    MPI_Count                    n_bytes;
+    internal::CompressionBuffers buffers;
+    int                          ierr = internal::setup_compression(
+      count, datatype, codec, default_codec, used, &n_bytes, buffers);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    std::vector<std::vector<char>> &staging = buffers.staging;
+
+    const MPI_Count n_chunks = internal::n_compression_chunks(n_bytes);
+    std::vector<std::uint64_t> header(2 + n_chunks);
+    header[0] = n_bytes;
+    header[1] = compression_chunk_bytes;
+
+    // the chunks follow the header, which is written once their sizes are
+    // known
+    MPI_Offset position =
+      offset + header.size() * static_cast<MPI_Offset>(sizeof(std::uint64_t));
+    MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+
+    for (MPI_Count chunk = 0; chunk < n_chunks; ++chunk)
+      {
+        MPI_COMPAT_TRACE_SCOPE("chunk");
+        ierr = MPI_Wait(&requests[chunk % 2], MPI_STATUS_IGNORE);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+
+        const std::size_t size =
+          used->compress(static_cast<const char *>(buf) +
+                           chunk * compression_chunk_bytes,
+                         internal::compression_chunk_size(n_bytes, chunk),
+                         staging[chunk % 2].data(),
+                         buffers.scratch.data());
+        header[2 + chunk] = size;
+        ierr              = MPI_File_iwrite_at(fh,
+                                  position,
+                                  staging[chunk % 2].data(),
+                                  size,
+                                  MPI_BYTE,
+                                  &requests[chunk % 2]);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+        position += size;
+      }
+    ierr = MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = File_write_at_c(fh,
+                           offset,
+                           header.data(),
+                           header.size(),
+                           MPI_UINT64_T,
+                           MPI_STATUS_IGNORE);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    if (extent != nullptr)
+      *extent = position - offset;
+    if (status != MPI_STATUS_IGNORE)
+      return MPI_Status_set_elements_x(status, datatype, count);
+    return MPI_SUCCESS;
+  }
+
+  /**
+   * Read data written by File_write_at_compressed_c() at @p offset, using
+   * the sizes stored in the file. Every chunk is decompressed while the
+   * next one is being read. Returns MPI_ERR_COUNT if the file does not
+   * hold @p count elements of @p datatype and MPI_ERR_OTHER if @p codec
+   * can not restore a chunk.
+   *
+   * The datatype has to be contiguous and the file view has to use MPI_BYTE
+   * as elementary type, like the default view.
+   */
+  inline int
+  File_read_at_compressed_c(MPI_File      fh,
+                            MPI_Offset    offset,
+                            void *        buf,
+                            MPI_Count     count,
+                            MPI_Datatype  datatype,
+                            MPI_Status *  status,
+                            const Codec * codec = nullptr)
+  {
+    MPI_COMPAT_TRACE_SCOPE("File_read_at_compressed_c");
+    MPI_Count n_bytes;
+    int       ierr = internal::contiguous_bytes(count, datatype, &n_bytes);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    // the chunk size is taken from the file, so that it does not have to
+    // match compression_chunk_bytes of this build
+    std::vector<std::uint64_t> header(2);
+    ierr = MPI_File_read_at(
+      fh, offset, header.data(), 2, MPI_UINT64_T, MPI_STATUS_IGNORE);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    const MPI_Count chunk_bytes = header[1];
+    if (header[0] != static_cast<std::uint64_t>(n_bytes) || chunk_bytes <= 0 ||
+        chunk_bytes > BigMPICompat::mpi_max_int_count)
+      return MPI_ERR_COUNT;
+
+    ShuffleLZCodec               default_codec;
+    const Codec *                used;
+    internal::CompressionBuffers buffers;
+    ierr = internal::setup_compression(count,
+                                       datatype,
+                                       codec,
+                                       default_codec,
+                                       used,
+                                       &n_bytes,
+                                       buffers,
+                                       chunk_bytes);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    std::vector<std::vector<char>> &staging = buffers.staging;
+
+    const MPI_Count n_chunks =
+      internal::n_compression_chunks(n_bytes, chunk_bytes);
+    header.resize(2 + n_chunks);
+    ierr = File_read_at_c(fh,
+                          offset + 2 * sizeof(std::uint64_t),
+                          header.data() + 2,
+                          n_chunks,
+                          MPI_UINT64_T,
+                          MPI_STATUS_IGNORE);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    const std::uint64_t *chunk_sizes = header.data() + 2;
+    for (MPI_Count chunk = 0; chunk < n_chunks; ++chunk)
+      if (chunk_sizes[chunk] > staging[0].size())
+        return MPI_ERR_COUNT;
+
+    MPI_Offset position =
+      offset + header.size() * static_cast<MPI_Offset>(sizeof(std::uint64_t));
+    MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    bool        corrupt     = false;
+    char *      data        = static_cast<char *>(buf);
+
+    for (MPI_Count chunk = 0; chunk < n_chunks + 1; ++chunk)
+      {
+        MPI_COMPAT_TRACE_SCOPE("chunk");
+        if (chunk < n_chunks)
+          {
+            ierr = MPI_File_iread_at(fh,
+                                     position,
+                                     staging[chunk % 2].data(),
+                                     static_cast<int>(chunk_sizes[chunk]),
+                                     MPI_BYTE,
+                                     &requests[chunk % 2]);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+            position += chunk_sizes[chunk];
+          }
+
+        if (chunk > 0)
+          {
+            const MPI_Count previous = chunk - 1;
+            ierr = MPI_Wait(&requests[previous % 2], MPI_STATUS_IGNORE);
+            if (ierr != MPI_SUCCESS)
+              return ierr;
+            if (!used->decompress(staging[previous % 2].data(),
+                                  chunk_sizes[previous],
+                                  data + previous * chunk_bytes,
+                                  internal::compression_chunk_size(
+                                    n_bytes, previous, chunk_bytes),
+                                  buffers.scratch.data()))
+              corrupt = true;
+          }
+      }
+
+    if (status != MPI_STATUS_IGNORE)
+      {
+        ierr = MPI_Status_set_elements_x(status, datatype, count);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+    return corrupt ? MPI_ERR_OTHER : MPI_SUCCESS;
+  }
+
+#ifdef MPI_COMPAT_WITH_TRACING
+  namespace internal
+  {
+    /**
+     * Names of events longer than this are truncated in the trace file.
+     */
+    static constexpr std::size_t trace_max_name_length = 200;
+
+    /**
+     * Append @p name to @p text as the contents of a JSON string: quotes,
+     * backslashes and control characters are escaped, and at most
+     * trace_max_name_length bytes are kept, without splitting a UTF-8
+     * character.
+     */
+    inline void
+    trace_append_json(std::string &text, const char *name)
+    {
+      std::size_t length = std::strlen(name);
+      if (length > trace_max_name_length)
+        {
+          length = trace_max_name_length;
+          while (length > 0 && (name[length] & 0xc0) == 0x80)
+            --length;
+        }
+
+      for (std::size_t i = 0; i < length; ++i)
+        {
+          const unsigned char c = name[i];
+          if (c == '"' || c == '\\')
+            {
+              text += '\\';
+              text += c;
+            }
+          else if (c < 0x20)
+            {
+              char escaped[8];
+              std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+              text += escaped;
+            }
+          else
+            text += c;
+        }
+    }
+
+    /**
+     * Write the trace of all processes in the communicator passed to
+     * Trace_start() into its file as a Chrome trace-event JSON document
+     * (to be opened in chrome://tracing or https://ui.perfetto.dev) and
+     * stop tracing. Every process is shown as one row, with the times
+     * relative to the synchronized start of the trace.
+     */
+    inline int
+    trace_write()
+    {
+      TraceBuffer &buffer = trace_buffer();
+      if (!buffer.enabled)
+        return MPI_SUCCESS;
+      buffer.enabled = false;
+      while (buffer.n_writers != 0)
+        std::this_thread::yield();
+
+      int myid, n_ranks;
+      int ierr = MPI_Comm_rank(buffer.comm, &myid);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      ierr = MPI_Comm_size(buffer.comm, &n_ranks);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      const std::uint64_t n_recorded = buffer.n_recorded;
+      const std::uint64_t capacity   = buffer.events.size();
+      const std::uint64_t first =
+        (n_recorded > capacity) ? n_recorded - capacity : 0;
+
+      std::string text = (myid == 0) ? "{\"traceEvents\":[\n" : ",\n";
+      char        line[256];
+      std::snprintf(line,
+                    sizeof(line),
+                    "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                    "\"args\":{\"name\":\"rank %d (%llu events dropped)\"}}",
+                    myid,
+                    myid,
+                    static_cast<unsigned long long>(first));
+      text += line;
+      for (std::uint64_t i = first; i < n_recorded; ++i)
+        {
+          const TraceEvent &event = buffer.events[i % capacity];
+          text += ",\n{\"name\":\"";
+          trace_append_json(text, event.name);
+          std::snprintf(line,
+                        sizeof(line),
+                        "\",\"cat\":\"BigMPICompat\","
+                        "\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,"
+                        "\"dur\":%.3f}",
+                        myid,
+                        event.thread,
+                        (event.begin - buffer.start_time) * 1e6,
+                        (event.end - event.begin) * 1e6);
+          text += line;
+        }
+      if (myid == n_ranks - 1)
+        text += "\n]}\n";
+
+      // every process writes its part of the file right after the parts
+      // of the processes before it
+      long long size = text.size(), offset = 0;
+      ierr = MPI_Exscan(&size, &offset, 1, MPI_LONG_LONG, MPI_SUM, buffer.comm);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      if (myid == 0)
+        offset = 0;
+
+      MPI_File fh;
+      ierr = MPI_File_open(buffer.comm,
+                           buffer.filename.c_str(),
+                           MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                           MPI_INFO_NULL,
+                           &fh);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      ierr = MPI_File_set_size(fh, 0);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      ierr = File_write_at_all_c(
+        fh, offset, text.data(), text.size(), MPI_CHAR, MPI_STATUS_IGNORE);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      ierr = MPI_File_close(&fh);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      std::vector<TraceEvent>().swap(buffer.events);
+      return MPI_Comm_free(&buffer.comm);
+    }
+
+    /**
+     * Attribute delete callback on MPI_COMM_SELF, called at the beginning
+     * of MPI_Finalize() or from Trace_stop().
+     */
+    inline int
+    trace_delete_callback(MPI_Comm, int, void *, void *)
+    {
+      return trace_write();
+    }
+  } // namespace internal
+
+  /**
+   * Start recording the begin and end of every BigMPICompat call and of
+   * its internal phases (for example every chunk of a transfer) on all
+   * processes of @p comm. This is collective on @p comm.
+   *
+   * Every process keeps the last @p capacity events in a buffer allocated
+   * here, so recording does not allocate memory. The traces are written to
+   * @p filename as a single Chrome trace-event JSON file by Trace_stop(),
+   * or at the beginning of MPI_Finalize() at the latest.
+   *
+   * This is only available if MPI_COMPAT_WITH_TRACING is defined before
+   * including this file. Use MPI_COMPAT_TRACE_SCOPE to add phases of the
+   * application to the trace.
+   */
+  inline int
+  Trace_start(const char *filename,
+              MPI_Comm    comm     = MPI_COMM_WORLD,
+              std::size_t capacity = MPI_COMPAT_TRACE_CAPACITY)
+  {
+    internal::TraceBuffer &buffer = internal::trace_buffer();
+    if (buffer.enabled || capacity == 0)
+      return MPI_ERR_OTHER;
+
+    int ierr = MPI_Comm_dup(comm, &buffer.comm);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    buffer.filename = filename;
+    buffer.events.assign(capacity, internal::TraceEvent());
+    buffer.n_recorded = 0;
+
+    if (buffer.keyval == MPI_KEYVAL_INVALID)
+      {
+        ierr = MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN,
+                                      &internal::trace_delete_callback,
+                                      &buffer.keyval,
+                                      nullptr);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+    ierr = MPI_Comm_set_attr(MPI_COMM_SELF, buffer.keyval, nullptr);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = MPI_Barrier(buffer.comm);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    buffer.start_time = MPI_Wtime();
+    buffer.enabled    = true;
+    return MPI_SUCCESS;
+  }
+
+  /**
+   * Stop the trace started by Trace_start() and write it. This is
+   * collective on the communicator passed to Trace_start(). Other threads
+   * may keep recording events meanwhile: the trace waits for those that
+   * are in the middle of recording one, and drops all later ones.
+   */
+  inline int
+  Trace_stop()
+  {
+    internal::TraceBuffer &buffer = internal::trace_buffer();
+    if (buffer.keyval == MPI_KEYVAL_INVALID)
+      return MPI_SUCCESS;
+
+    // deleting the attribute writes the trace through the callback
+    int ierr = MPI_Comm_delete_attr(MPI_COMM_SELF, buffer.keyval);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    return MPI_Comm_free_keyval(&buffer.keyval);
+  }
+#endif
+
+#if MPI_VERSION < 4
+  namespace internal
+  {
+    /**
+     * Set up an emulated partitioned send (@p is_recv false) or receive:
+     * one persistent request per partition on @p comm with the tags
+     * @p tag, ..., @p tag + @p partitions - 1, behind a placeholder request
+     * returned in @p request.
+     */
+    inline int
+    partitioned_init(void *       buf,
+                     int          partitions,
+                     MPI_Count    count,
+                     MPI_Datatype datatype,
+                     int          peer,
+                     int          tag,
+                     MPI_Comm     comm,
+                     bool         is_recv,
+                     MPI_Request *request)
+    {
+      if (partitions <= 0)
+        return MPI_ERR_ARG;
+
+      void *tag_ub;
+      int   flag;
+      int   ierr = MPI_Comm_get_attr(comm, MPI_TAG_UB, &tag_ub, &flag);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+      if (tag < 0 || (flag && static_cast<MPI_Count>(tag) + partitions - 1 >
+                                *static_cast<int *>(tag_ub)))
+        return MPI_ERR_TAG;
+
+      MPI_Aint lb, extent;
+      ierr = MPI_Type_get_extent(datatype, &lb, &extent);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      std::vector<MPI_Request> requests(partitions, MPI_REQUEST_NULL);
+      for (int i = 0; i < partitions; ++i)
+        {
+          char *data = static_cast<char *>(buf) + i * count * extent;
+          if (is_recv)
+            ierr = Recv_init_c(
+              data, count, datatype, peer, tag + i, comm, &requests[i]);
+          else
+            ierr = Send_init_c(
+              data, count, datatype, peer, tag + i, comm, &requests[i]);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+        }
+
+      ierr = MPI_Recv_init(
+        nullptr, 0, MPI_BYTE, MPI_PROC_NULL, 0, MPI_COMM_SELF, request);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      internal::RequestData &data = internal::request_data()[*request];
+      data.partitions.swap(requests);
+      data.is_precv = is_recv;
+
+      // an inactive request counts as complete, like after the last round
+      data.n_started = std::make_shared<std::atomic<int>>(partitions);
+      return MPI_SUCCESS;
+    }
+
+    /**
+     * Return the persistent request of @p partition of the emulated
+     * partitioned operation @p request, or MPI_REQUEST_NULL if there is
+     * none.
+     */
+    inline MPI_Request *
+    partition_request(MPI_Request request, int partition)
+    {
+      auto it = request_data().find(request);
+      if (it == request_data().end() || partition < 0 ||
+          partition >= static_cast<int>(it->second.partitions.size()))
+        return nullptr;
+      return &it->second.partitions[partition];
+    }
+  } // namespace internal
+#endif
+
+  /**
+   * Create a partitioned send of @p partitions partitions of (possibly
+   * large) @p count elements each. After Start(), every partition is sent
+   * as soon as it is marked ready with Pready(), for example by the thread
+   * that produced it. Complete the request with BigMPICompat::Test() or
+   * BigMPICompat::Wait() and free it with BigMPICompat::Request_free().
+   *
+   * Without native support, every partition is a persistent send on
+   * @p comm with the tag @p tag plus the number of the partition, so the
+   * tags up to @p tag + @p partitions - 1 must not be used by other
+   * messages between the two processes while the operation is active,
+   * and the receive has to use the same number of partitions (which MPI
+   * itself does not require). Pready() may be called from several threads
+   * at once (with MPI_THREAD_MULTIPLE) if no other thread creates or frees
+   * requests through BigMPICompat at the same time, also while another
+   * thread is in BigMPICompat::Wait() for the request, which returns once
+   * all partitions were marked ready and sent.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Psend_init_c(const void * buf,
+               int          partitions,
+               MPI_Count    count,
+               MPI_Datatype datatype,
+               int          dest,
+               int          tag,
+               MPI_Comm     comm,
+               MPI_Info     info,
+               MPI_Request *request)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Psend_init_c");
+#if MPI_VERSION >= 4
+    return MPI_Psend_init(
+      buf, partitions, count, datatype, dest, tag, comm, info, request);
+#else
+    (void)info;
+    return internal::partitioned_init(const_cast<void *>(buf),
+                                      partitions,
+                                      count,
+                                      datatype,
+                                      dest,
+                                      tag,
+                                      comm,
+                                      false,
+                                      request);
+#endif
+  }
+
+  /**
+   * Create the partitioned receive matching Psend_init_c(). All partitions
+   * are received once the request is started, and Parrived() tells which
+   * ones are complete already.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Precv_init_c(void *       buf,
+               int          partitions,
+               MPI_Count    count,
+               MPI_Datatype datatype,
+               int          source,
+               int          tag,
+               MPI_Comm     comm,
+               MPI_Info     info,
+               MPI_Request *request)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Precv_init_c");
+#if MPI_VERSION >= 4
+    return MPI_Precv_init(
+      buf, partitions, count, datatype, source, tag, comm, info, request);
+#else
+    (void)info;
+    return internal::partitioned_init(
+      buf, partitions, count, datatype, source, tag, comm, true, request);
+#endif
+  }
+
+  /**
+   * Mark @p partition of the started partitioned send @p request as ready
+   * to be sent.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Pready(int partition, MPI_Request request)
+  {
+    MPI_COMPAT_TRACE_SCOPE("Pready");
+#if MPI_VERSION >= 4
+    return MPI_Pready(partition, request);
+#else
+    MPI_Request *partition_request =
+      internal::partition_request(request, partition);
+    if (partition_request == nullptr)
+      return MPI_ERR_ARG;
+    const int ierr = Start(partition_request);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    // from now on Test() and Wait() may complete the partition
+    ++*internal::request_data().find(request)->second.n_started;
+    return MPI_SUCCESS;
+#endif
+  }
+
+  /**
+   * Mark the partitions @p partition_low to @p partition_high (inclusive)
+   * of @p request as ready, see Pready().
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Pready_range(int partition_low, int partition_high, MPI_Request request)
+  {
+#if MPI_VERSION >= 4
+    return MPI_Pready_range(partition_low, partition_high, request);
+#else
+    for (int partition = partition_low; partition <= partition_high;
+         ++partition)
+      {
+        const int ierr = Pready(partition, request);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+    return MPI_SUCCESS;
+#endif
+  }
+
+  /**
+   * Mark the @p length partitions @p array_of_partitions of @p request as
+   * ready, see Pready().
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Pready_list(int length, const int array_of_partitions[], MPI_Request request)
+  {
+#if MPI_VERSION >= 4
+    return MPI_Pready_list(length, array_of_partitions, request);
+#else
+    for (int i = 0; i < length; ++i)
+      {
+        const int ierr = Pready(array_of_partitions[i], request);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+    return MPI_SUCCESS;
+#endif
+  }
+
+  /**
+   * Set @p flag to whether @p partition of the started partitioned receive
+   * @p request has arrived.
+   *
+   * See the MPI 4.x standard for details.
+   */
+  inline int
+  Parrived(MPI_Request request, int partition, int *flag)
+  {
+#if MPI_VERSION >= 4
+    return MPI_Parrived(request, partition, flag);
+#else
+    MPI_Request *partition_request =
+      internal::partition_request(request, partition);
+    if (partition_request == nullptr)
+      return MPI_ERR_ARG;
+    return Test(partition_request, flag, MPI_STATUS_IGNORE);
+#endif
+  }
+
+  /**
+   * File_read_bcast_c() reads and broadcasts the data in chunks of this
+   * many bytes.
+   */
+  static constexpr MPI_Count read_bcast_chunk_bytes =
+    (BigMPICompat::mpi_max_int_count < (1 << 26)) ?
+      BigMPICompat::mpi_max_int_count :
+      (1 << 26);
+
+  namespace internal
+  {
+    /**
+     * Read @p n_bytes at @p offset of @p fh into @p buf on the process
+     * @p reader of @p comm and broadcast them to all processes of @p comm.
+     * The next chunk is read while the previous one is broadcast, and at
+     * most two broadcasts are in flight.
+     */
+    inline int
+    read_bcast(MPI_File   fh,
+               MPI_Offset offset,
+               char *     buf,
+               MPI_Count  n_bytes,
+               int        reader,
+               MPI_Comm   comm)
+    {
+      int myid;
+      int ierr = MPI_Comm_rank(comm, &myid);
+      if (ierr != MPI_SUCCESS)
+        return ierr;
+
+      const MPI_Count n_chunks =
+        (n_bytes + read_bcast_chunk_bytes - 1) / read_bcast_chunk_bytes;
+      auto chunk_size = [n_bytes](MPI_Count chunk) {
+        return static_cast<int>(std::min(
+          read_bcast_chunk_bytes, n_bytes - chunk * read_bcast_chunk_bytes));
+      };
+
+      MPI_Request read = MPI_REQUEST_NULL;
+      MPI_Request bcasts[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+      if (myid == reader && n_chunks > 0)
+        {
+          ierr = MPI_File_iread_at(
+            fh, offset, buf, chunk_size(0), MPI_BYTE, &read);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+        }
+
+      for (MPI_Count chunk = 0; chunk < n_chunks; ++chunk)
+        {
+          MPI_COMPAT_TRACE_SCOPE("chunk");
+          if (myid == reader)
+            {
+              ierr = MPI_Wait(&read, MPI_STATUS_IGNORE);
+              if (ierr != MPI_SUCCESS)
+                return ierr;
+              if (chunk + 1 < n_chunks)
+                {
+                  ierr = MPI_File_iread_at(
+                    fh,
+                    offset + (chunk + 1) * read_bcast_chunk_bytes,
+                    buf + (chunk + 1) * read_bcast_chunk_bytes,
+                    chunk_size(chunk + 1),
+                    MPI_BYTE,
+                    &read);
+                  if (ierr != MPI_SUCCESS)
+                    return ierr;
+                }
+            }
+
+          ierr = MPI_Wait(&bcasts[chunk % 2], MPI_STATUS_IGNORE);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+          ierr = MPI_Ibcast(buf + chunk * read_bcast_chunk_bytes,
+                            chunk_size(chunk),
+                            MPI_BYTE,
+                            reader,
+                            comm,
+                            &bcasts[chunk % 2]);
+          if (ierr != MPI_SUCCESS)
+            return ierr;
+        }
+      return MPI_Waitall(2, bcasts, MPI_STATUSES_IGNORE);
+    }
+  } // namespace internal
+
+  /**
+   * Read a (possibly large) @p count of data at @p offset of @p fh on the
+   * process @p root of @p comm and broadcast it into @p buf on all
+   * processes of @p comm, like File_read_at_c() on @p root followed by
+   * Bcast_c(). The data is read and broadcast in chunks of
+   * read_bcast_chunk_bytes, and the next chunk is read while the previous
+   * one is broadcast, so this takes about as long as the slower of the two
+   * instead of their sum.
+   *
+   * @p fh is only used on @p root and may be MPI_FILE_NULL elsewhere. The
+   * datatype has to be contiguous and the file view has to use MPI_BYTE as
+   * elementary type, like the default view.
+   */
+  inline int
+  File_read_bcast_c(MPI_File     fh,
+                    MPI_Offset   offset,
+                    void *       buf,
+                    MPI_Count    count,
+                    MPI_Datatype datatype,
+                    int          root,
+                    MPI_Comm     comm)
+  {
+    MPI_COMPAT_TRACE_SCOPE("File_read_bcast_c");
+    MPI_Count n_bytes;
+    int       ierr = internal::contiguous_bytes(count, datatype, &n_bytes);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    return internal::read_bcast(
+      fh, offset, static_cast<char *>(buf), n_bytes, root, comm);
+  }
+
+  /**
+   * Like File_read_bcast_c() above, but with a choice of @p algorithm.
+   *
+   * With CollectiveAlgorithm::node_aggregated, the first process of every
+   * node reads the file and broadcasts it only to the processes on its
+   * node, which avoids the network but reads the file once per node.
+   * @p fh is then used on the first process of every node, and @p root is
+   * ignored.
+   */
+  inline int
+  File_read_bcast_c(MPI_File            fh,
+                    MPI_Offset          offset,
+                    void *              buf,
+                    MPI_Count           count,
+                    MPI_Datatype        datatype,
+                    int                 root,
+                    MPI_Comm            comm,
+                    CollectiveAlgorithm algorithm)
+  {
+    MPI_COMPAT_TRACE_SCOPE("File_read_bcast_c");
+    if (algorithm == CollectiveAlgorithm::direct)
+      return File_read_bcast_c(fh, offset, buf, count, datatype, root, comm);
+
+    MPI_Count n_bytes;
+    int       ierr = internal::contiguous_bytes(count, datatype, &n_bytes);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    MPI_Comm node;
+    ierr = internal::node_comm(comm, &node);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    return internal::read_bcast(
+      fh, offset, static_cast<char *>(buf), n_bytes, 0, node);
+  }
+
+  /**
+   * Like File_read_bcast_c(), but the data lands in a shared memory window
+   * with a single copy per node: the pointer at @p baseptr is set to it on
+   * every process of the node, like in Win_allocate_shared_c(), and @p win
+   * has to be freed with MPI_Win_free() by all processes of @p comm when
+   * the data is no longer needed.
+   *
+   * The first process of the node of @p root reads the file and broadcasts
+   * the data to the first processes of the other nodes only, which store
+   * it directly in their window. @p fh is only used on the first process
+   * of the node of @p root and may be MPI_FILE_NULL elsewhere.
+   */
+  inline int
+  File_read_bcast_shared_c(MPI_File     fh,
+                           MPI_Offset   offset,
+                           MPI_Count    count,
+                           MPI_Datatype datatype,
+                           int          root,
+                           MPI_Comm     comm,
+                           void *       baseptr,
+                           MPI_Win *    win)
+  {
+    MPI_COMPAT_TRACE_SCOPE("File_read_bcast_shared_c");
+    MPI_Count n_bytes;
+    int       ierr = internal::contiguous_bytes(count, datatype, &n_bytes);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    MPI_Comm node;
+    ierr = internal::node_comm(comm, &node);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    int node_rank;
+    ierr = MPI_Comm_rank(node, &node_rank);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    ierr = Win_allocate_shared_c((node_rank == 0) ? n_bytes : 0,
+                                 1,
+                                 MPI_INFO_NULL,
+                                 node,
+                                 baseptr,
+                                 win);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    MPI_Aint size;
+    int      disp_unit;
+    char *   data;
+    ierr = MPI_Win_shared_query(*win, 0, &size, &disp_unit, &data);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    *static_cast<char **>(baseptr) = data;
+
+    // The first processes of all nodes broadcast among themselves. Every
+    // process learns the rank of the first process of its node in that
+    // communicator, and root tells everybody which one reads.
+    MPI_Comm leaders;
+    ierr = internal::leaders_comm(comm, &leaders);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    int reader = 0;
+    if (node_rank == 0)
+      {
+        ierr = MPI_Comm_rank(leaders, &reader);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+    ierr = MPI_Bcast(&reader, 1, MPI_INT, 0, node);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = MPI_Bcast(&reader, 1, MPI_INT, root, comm);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+
+    if (node_rank == 0)
+      {
+        ierr =
+          internal::read_bcast(fh, offset, data, n_bytes, reader, leaders);
+        if (ierr != MPI_SUCCESS)
+          return ierr;
+      }
+
+    // make the data written by the first process visible on the node
+    ierr = MPI_Win_lock_all(MPI_MODE_NOCHECK, *win);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = MPI_Win_sync(*win);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = MPI_Barrier(node);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    ierr = MPI_Win_sync(*win);
+    if (ierr != MPI_SUCCESS)
+      return ierr;
+    return MPI_Win_unlock_all(*win);
+  }
+
 } // namespace BigMPICompat
 
 #endif
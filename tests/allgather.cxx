@@ -0,0 +1,167 @@
+#include <big_mpi_compat.h>
+
+#include "common.h"
+
+
+void
+test_allgather(const bool nonblocking, const bool in_place)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid, ranks;
+  MPI_Comm_rank(comm, &myid);
+  MPI_Comm_size(comm, &ranks);
+
+  // every rank contributes more than 2^31 elements, which are not a
+  // multiple of the segment size
+  const std::uint64_t count = large_count(1, 3);
+
+  LargeBuffer<char> recvbuf(count * ranks);
+  LargeBuffer<char> sendbuf(in_place ? 0 : count);
+  char *            block = in_place ? recvbuf.data() + myid * count :
+                                       sendbuf.data();
+  block[0]                = 'a' + myid;
+  block[count - 1]        = 'A' + myid;
+
+  int ierr;
+  if (nonblocking)
+    {
+      MPI_Request request;
+      ierr = BigMPICompat::Iallgather_c(in_place ? MPI_IN_PLACE :
+                                                   sendbuf.data(),
+                                        count,
+                                        MPI_CHAR,
+                                        recvbuf.data(),
+                                        count,
+                                        MPI_CHAR,
+                                        comm,
+                                        &request);
+      CheckMPIFatal(ierr);
+
+      // advance the ring with Test() once, and with Wait() once
+      if (in_place)
+        {
+          int flag = 0;
+          while (!flag)
+            {
+              ierr = BigMPICompat::Test(&request, &flag, MPI_STATUS_IGNORE);
+              CheckMPIFatal(ierr);
+            }
+        }
+      else
+        {
+          ierr = BigMPICompat::Wait(&request, MPI_STATUS_IGNORE);
+          CheckMPIFatal(ierr);
+        }
+    }
+  else
+    {
+      ierr = BigMPICompat::Allgather_c(in_place ? MPI_IN_PLACE :
+                                                  sendbuf.data(),
+                                       count,
+                                       MPI_CHAR,
+                                       recvbuf.data(),
+                                       count,
+                                       MPI_CHAR,
+                                       comm);
+      CheckMPIFatal(ierr);
+    }
+
+  for (int i = 0; i < ranks; ++i)
+    if (recvbuf[i * count] != 'a' + i || recvbuf[i * count + 1] != 0 ||
+        recvbuf[(i + 1) * count - 1] != 'A' + i)
+      {
+        std::cerr << "MPI ALLGATHER WAS INVALID on rank " << myid
+                  << " for block " << i << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+
+  if (myid == 0)
+    std::cout << "TEST " << (nonblocking ? "iallgather" : "allgather")
+              << (in_place ? " in place" : "") << ": OK" << std::endl;
+}
+
+void
+test_overlapping_iallgather()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid, ranks;
+  MPI_Comm_rank(comm, &myid);
+  MPI_Comm_size(comm, &ranks);
+
+  const std::uint64_t count = large_count(1, 3);
+
+  // two operations in flight on the same communicator, with different data
+  LargeBuffer<char> sendbuf[2] = {LargeBuffer<char>(count),
+                                  LargeBuffer<char>(count)};
+  LargeBuffer<char> recvbuf[2] = {LargeBuffer<char>(count * ranks),
+                                  LargeBuffer<char>(count * ranks)};
+
+  // the matching depends on timing, so try a few times
+  for (unsigned int repetition = 0; repetition < 5; ++repetition)
+    {
+      MPI_Request requests[2];
+      for (unsigned int op = 0; op < 2; ++op)
+        {
+          std::fill(recvbuf[op].data(), recvbuf[op].data() + count * ranks, 0);
+          std::fill(sendbuf[op].data(),
+                    sendbuf[op].data() + count,
+                    static_cast<char>(1 + 16 * op + myid));
+          int ierr = BigMPICompat::Iallgather_c(sendbuf[op].data(),
+                                                count,
+                                                MPI_CHAR,
+                                                recvbuf[op].data(),
+                                                count,
+                                                MPI_CHAR,
+                                                comm,
+                                                &requests[op]);
+          CheckMPIFatal(ierr);
+        }
+
+      // complete them in a different order on neighboring ranks, so that
+      // the later steps of the two rings are posted in a different order
+      for (unsigned int i = 0; i < 2; ++i)
+        {
+          int ierr = BigMPICompat::Wait(&requests[(i + myid) % 2],
+                                        MPI_STATUS_IGNORE);
+          CheckMPIFatal(ierr);
+        }
+
+      for (unsigned int op = 0; op < 2; ++op)
+        for (int i = 0; i < ranks; ++i)
+          if (!std::all_of(recvbuf[op].data() + i * count,
+                           recvbuf[op].data() + (i + 1) * count,
+                           [&](const char c) {
+                             return c == static_cast<char>(1 + 16 * op + i);
+                           }))
+            {
+              std::cerr << "MPI OVERLAPPING IALLGATHER WAS INVALID on rank "
+                        << myid << " for operation " << op << " and block "
+                        << i << std::endl;
+              MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+    }
+
+  if (myid == 0)
+    std::cout << "TEST overlapping iallgather: OK" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int myid, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  assert(ranks >= 2);
+
+  test_allgather(false, false);
+  test_allgather(false, true);
+  test_allgather(true, false);
+  test_allgather(true, true);
+  test_overlapping_iallgather();
+
+  MPI_Finalize();
+  return 0;
+}
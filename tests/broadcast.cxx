@@ -10,11 +10,11 @@ test()
   int      myid;
   MPI_Comm_rank(comm, &myid);
 
-  const std::uint64_t count = (1ULL << 32) + 5;
+  const std::uint64_t count = large_count(2, 5);
 
   if (myid == 0)
     {
-      std::vector<short> buffer(count, 0);
+      LargeBuffer<short> buffer(count);
       buffer[1]         = 1;
       buffer[count - 1] = 99;
       int ierr          = BigMPICompat::Bcast_c(buffer.data(),
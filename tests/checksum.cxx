@@ -0,0 +1,231 @@
+#include <big_mpi_compat.h>
+
+#include "common.h"
+
+#include <cstring>
+
+
+void
+test_crc32c()
+{
+  // the check value of CRC32C from the standard catalog of CRCs
+  const char *check = "123456789";
+  if (BigMPICompat::Crc32c(check, 9) != 0xE3069283u)
+    {
+      std::cerr << "CRC32C WAS INVALID: " << BigMPICompat::Crc32c(check, 9)
+                << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  // computing the checksum in pieces gives the same result, and the
+  // software fallback agrees with the (possibly) accelerated version
+  std::vector<unsigned char> data(1000);
+  for (unsigned int i = 0; i < data.size(); ++i)
+    data[i] = (i * 7919) % 251;
+  const std::uint32_t full = BigMPICompat::Crc32c(data.data(), data.size());
+  const std::uint32_t pieces = BigMPICompat::Crc32c(
+    data.data() + 333, 667, BigMPICompat::Crc32c(data.data(), 333));
+  const std::uint32_t software = ~BigMPICompat::internal::crc32c_software(
+    ~0u, data.data(), data.size());
+  if (full != pieces || full != software)
+    {
+      std::cerr << "CRC32C WAS INCONSISTENT: " << full << ' ' << pieces << ' '
+                << software << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+}
+
+void
+test_send_recv_checked()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid;
+  MPI_Comm_rank(comm, &myid);
+
+  const std::uint64_t count = large_count(2, 5);
+
+  if (myid == 0)
+    {
+      LargeBuffer<short> buffer(count);
+      buffer[count - 1] = 2;
+      int ierr          = BigMPICompat::Send_checked_c(
+        buffer.data(), count, MPI_SHORT, 1 /* dest */, 0 /* tag */, comm);
+      CheckMPIFatal(ierr);
+    }
+  else if (myid == 1)
+    {
+      std::vector<short> buffer(count, 42);
+      MPI_Status         status;
+      int                ierr = BigMPICompat::Recv_checked_c(buffer.data(),
+                                                count,
+                                                MPI_SHORT,
+                                                MPI_ANY_SOURCE,
+                                                0 /* tag */,
+                                                comm,
+                                                &status);
+      CheckMPIFatal(ierr);
+
+      MPI_Count received;
+      ierr = MPI_Get_elements_x(&status, MPI_SHORT, &received);
+      CheckMPIFatal(ierr);
+
+      if (buffer[0] != 0 || buffer[count - 1] != 2 ||
+          status.MPI_SOURCE != 0 || received != MPI_Count(count))
+        {
+          std::cerr << "MPI CHECKED RECEIVE WAS INVALID:" << buffer[0] << ' '
+                    << buffer[count - 1] << std::endl;
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+  if (myid == 0)
+    std::cout << "TEST send_recv_checked: OK" << std::endl;
+}
+
+void
+test_bcast_checked()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid;
+  MPI_Comm_rank(comm, &myid);
+
+  const std::uint64_t count = large_count(2, 5);
+
+  std::vector<short> buffer(count, 42);
+  if (myid == 0)
+    {
+      buffer[1]         = 1;
+      buffer[count - 1] = 99;
+    }
+  int ierr = BigMPICompat::Bcast_checked_c(
+    buffer.data(), count, MPI_SHORT, 0 /* root */, comm);
+  CheckMPIFatal(ierr);
+
+  if (buffer[0] != 42 || buffer[1] != 1 || buffer[count - 1] != 99)
+    {
+      std::cerr << "MPI CHECKED BCAST WAS INVALID:" << buffer[1] << ' '
+                << buffer[count - 1] << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  if (myid == 0)
+    std::cout << "TEST bcast_checked: OK" << std::endl;
+}
+
+void
+test_file_checked(const bool collective)
+{
+  int myid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+
+  // a different number of chunks on every other process
+  const std::uint64_t n_bytes = large_count(2 + myid % 2, 2);
+
+  // the checksums are stored right after the data of each process
+  MPI_Offset extent;
+  int ierr = BigMPICompat::File_checked_extent_c(n_bytes, MPI_CHAR, &extent);
+  CheckMPIFatal(ierr);
+  MPI_Offset offset = 0;
+  ierr = MPI_Exscan(&extent, &offset, 1, MPI_OFFSET, MPI_SUM, MPI_COMM_WORLD);
+  CheckMPIFatal(ierr);
+  if (myid == 0)
+    offset = 0;
+
+  MPI_File fh;
+  ierr =
+    MPI_File_open(MPI_COMM_WORLD,
+                  "checksum.data",
+                  MPI_MODE_CREATE | MPI_MODE_RDWR | MPI_MODE_DELETE_ON_CLOSE,
+                  MPI_INFO_NULL,
+                  &fh);
+  CheckMPIFatal(ierr);
+
+  {
+    std::vector<char> buffer(n_bytes, '?');
+    buffer[0] = 'A' + myid;
+    if (collective)
+      ierr = BigMPICompat::File_write_at_all_checked_c(fh,
+                                                       offset,
+                                                       buffer.data(),
+                                                       n_bytes,
+                                                       MPI_CHAR,
+                                                       MPI_STATUS_IGNORE);
+    else
+      ierr = BigMPICompat::File_write_at_checked_c(fh,
+                                                   offset,
+                                                   buffer.data(),
+                                                   n_bytes,
+                                                   MPI_CHAR,
+                                                   MPI_STATUS_IGNORE);
+    CheckMPIFatal(ierr);
+  }
+
+  ierr = MPI_File_sync(fh);
+  CheckMPIFatal(ierr);
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  std::vector<char> buffer(n_bytes);
+  if (collective)
+    ierr = BigMPICompat::File_read_at_all_checked_c(
+      fh, offset, buffer.data(), n_bytes, MPI_CHAR, MPI_STATUS_IGNORE);
+  else
+    ierr = BigMPICompat::File_read_at_checked_c(
+      fh, offset, buffer.data(), n_bytes, MPI_CHAR, MPI_STATUS_IGNORE);
+  CheckMPIFatal(ierr);
+
+  if (buffer[0] != 'A' + myid || buffer[n_bytes - 1] != '?')
+    {
+      std::cerr << "CHECKED READ WAS INVALID" << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  // corrupt the last byte of our part of the file and make sure the
+  // checksums catch it
+  const char corrupt = '!';
+  ierr               = MPI_File_write_at(
+    fh, offset + n_bytes - 1, &corrupt, 1, MPI_CHAR, MPI_STATUS_IGNORE);
+  CheckMPIFatal(ierr);
+  ierr = MPI_File_sync(fh);
+  CheckMPIFatal(ierr);
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  if (collective)
+    ierr = BigMPICompat::File_read_at_all_checked_c(
+      fh, offset, buffer.data(), n_bytes, MPI_CHAR, MPI_STATUS_IGNORE);
+  else
+    ierr = BigMPICompat::File_read_at_checked_c(
+      fh, offset, buffer.data(), n_bytes, MPI_CHAR, MPI_STATUS_IGNORE);
+  if (ierr != MPI_ERR_OTHER)
+    {
+      std::cerr << "CORRUPTED FILE WAS NOT DETECTED" << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  ierr = MPI_File_close(&fh);
+  CheckMPIFatal(ierr);
+
+  if (myid == 0)
+    std::cout << "TEST file_checked " << (collective ? "at_all" : "at")
+              << ": OK" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int myid, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  assert(ranks >= 2);
+
+  test_crc32c();
+  test_send_recv_checked();
+  test_bcast_checked();
+  test_file_checked(false);
+  test_file_checked(true);
+
+  MPI_Finalize();
+  return 0;
+}
@@ -1,7 +1,11 @@
 #ifndef BIG_MPI_COMPAT_COMMON_H
 #define BIG_MPI_COMPAT_COMMON_H
 
+#include <sys/mman.h>
+
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <vector>
 
@@ -13,6 +17,107 @@
       MPI_Abort(MPI_COMM_WORLD, ierr);                                       \
     }
 
+/**
+ * Return the count @p factor * 2^31 + @p offset used by the tests.
+ *
+ * The low-memory variants of the tests are compiled with a small
+ * MPI_COMPAT_MAX_INT_COUNT, and 2^31 is replaced by
+ * BigMPICompat::mpi_max_int_count + 1. The tests then run through the same
+ * code paths for large counts with buffers of a few MiB.
+ */
+inline std::uint64_t
+large_count(const std::uint64_t factor, const std::int64_t offset = 0)
+{
+  return factor * (BigMPICompat::mpi_max_int_count + 1) + offset;
+}
+
+/**
+ * A zero-initialized array of @p n elements in an anonymous mapping with
+ * MAP_NORESERVE. Pages only use memory once they are written, so a large
+ * send buffer that is mostly zero costs almost nothing.
+ */
+template <typename T>
+class LargeBuffer
+{
+public:
+  explicit LargeBuffer(const std::uint64_t n)
+    : ptr(nullptr)
+    , n(n)
+  {
+    if (n == 0)
+      return;
+
+    void *p = mmap(nullptr,
+                   n * sizeof(T),
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                   -1,
+                   0);
+    if (p == MAP_FAILED)
+      {
+        std::cerr << "mmap of " << n * sizeof(T) << " bytes failed"
+                  << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+    ptr = static_cast<T *>(p);
+  }
+
+  ~LargeBuffer()
+  {
+    if (ptr != nullptr)
+      munmap(ptr, n * sizeof(T));
+  }
+
+  LargeBuffer(const LargeBuffer &) = delete;
+  LargeBuffer &
+  operator=(const LargeBuffer &) = delete;
+
+  T *
+  data()
+  {
+    return ptr;
+  }
+
+  std::uint64_t
+  size() const
+  {
+    return n;
+  }
+
+  T &
+  operator[](const std::uint64_t i)
+  {
+    return ptr[i];
+  }
+
+private:
+  T *           ptr;
+  std::uint64_t n;
+};
+
+/**
+ * FNV-1a hash that is computed piece by piece, so that large files can be
+ * checked while streaming through them.
+ */
+class StreamingChecksum
+{
+public:
+  void
+  update(const void *data, const std::uint64_t n_bytes)
+  {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (std::uint64_t i = 0; i < n_bytes; ++i)
+      hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+
+  std::uint64_t
+  value() const
+  {
+    return hash;
+  }
 
+private:
+  std::uint64_t hash = 14695981039346656037ULL;
+};
 
 #endif
@@ -0,0 +1,196 @@
+#include <big_mpi_compat.h>
+
+#include "common.h"
+
+
+/**
+ * Fill @p data with slowly growing integers, which compress well, followed
+ * by pseudo-random values that do not compress at all.
+ */
+void
+fill(LargeBuffer<int> &data)
+{
+  const std::uint64_t n_random = std::min<std::uint64_t>(data.size(), 1000);
+  for (std::uint64_t i = 0; i < data.size() - n_random; ++i)
+    data[i] = i / 16;
+
+  std::uint32_t state = 12345;
+  for (std::uint64_t i = data.size() - n_random; i < data.size(); ++i)
+    {
+      state   = state * 1664525u + 1013904223u;
+      data[i] = state;
+    }
+}
+
+void
+test_codec()
+{
+  // round trips through the codec with and without byte shuffle, for
+  // repetitive, random and tiny inputs
+  std::vector<char> input(100000);
+  std::uint32_t     state = 1;
+  for (unsigned int i = 0; i < input.size(); ++i)
+    {
+      state    = state * 1664525u + 1013904223u;
+      input[i] = (i < 60000) ? (i / 300) % 7 : (state >> 24);
+    }
+
+  for (const std::size_t element_size : {1, 4, 7})
+    for (const std::size_t n : {0, 1, 5, 100000})
+      {
+        const BigMPICompat::ShuffleLZCodec codec(element_size);
+        std::vector<char> compressed(codec.max_compressed_size(n));
+        const std::size_t size =
+          codec.compress(input.data(), n, compressed.data());
+
+        std::vector<char> output(n, '?');
+        if (size > compressed.size() ||
+            !codec.decompress(compressed.data(), size, output.data(), n) ||
+            !std::equal(output.begin(), output.end(), input.begin()))
+          {
+            std::cerr << "CODEC ROUND TRIP FAILED for " << n << " bytes"
+                      << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+          }
+        if (n == 100000 && size > 60000)
+          {
+            std::cerr << "CODEC DID NOT COMPRESS: " << size << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+          }
+
+        // a truncated input is detected
+        if (n == 100000 &&
+            codec.decompress(compressed.data(), size - 1, output.data(), n))
+          {
+            std::cerr << "CODEC ACCEPTED TRUNCATED INPUT" << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+          }
+      }
+}
+
+void
+test_send_recv_compressed()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid;
+  MPI_Comm_rank(comm, &myid);
+
+  const std::uint64_t count = large_count(1, 5);
+
+  LargeBuffer<int> expected(count);
+  fill(expected);
+
+  if (myid == 0)
+    {
+      int ierr = BigMPICompat::Send_compressed_c(
+        expected.data(), count, MPI_INT, 1 /* dest */, 0 /* tag */, comm);
+      CheckMPIFatal(ierr);
+    }
+  else if (myid == 1)
+    {
+      LargeBuffer<int> buffer(count);
+      MPI_Status       status;
+      int              ierr = BigMPICompat::Recv_compressed_c(buffer.data(),
+                                                 count,
+                                                 MPI_INT,
+                                                 MPI_ANY_SOURCE,
+                                                 0 /* tag */,
+                                                 comm,
+                                                 &status);
+      CheckMPIFatal(ierr);
+
+      MPI_Count received;
+      ierr = MPI_Get_elements_x(&status, MPI_INT, &received);
+      CheckMPIFatal(ierr);
+
+      if (!std::equal(buffer.data(),
+                      buffer.data() + count,
+                      expected.data()) ||
+          status.MPI_SOURCE != 0 || received != MPI_Count(count))
+        {
+          std::cerr << "MPI COMPRESSED RECEIVE WAS INVALID" << std::endl;
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+  if (myid == 0)
+    std::cout << "TEST send_recv_compressed: OK" << std::endl;
+}
+
+void
+test_file_compressed()
+{
+  int myid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+
+  const std::uint64_t count = large_count(1, 5);
+
+  MPI_File fh;
+  int      ierr =
+    MPI_File_open(MPI_COMM_SELF,
+                  ("compression.data." + std::to_string(myid)).c_str(),
+                  MPI_MODE_CREATE | MPI_MODE_RDWR | MPI_MODE_DELETE_ON_CLOSE,
+                  MPI_INFO_NULL,
+                  &fh);
+  CheckMPIFatal(ierr);
+
+  LargeBuffer<int> expected(count);
+  fill(expected);
+
+  MPI_Offset extent;
+  ierr = BigMPICompat::File_write_at_compressed_c(
+    fh, 0, expected.data(), count, MPI_INT, MPI_STATUS_IGNORE, &extent);
+  CheckMPIFatal(ierr);
+
+  if (extent >= MPI_Offset(count * sizeof(int)) / 2)
+    {
+      std::cerr << "FILE WAS NOT COMPRESSED: " << extent << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  // the file describes itself, so nothing but the offset is needed
+  LargeBuffer<int> buffer(count);
+  ierr = BigMPICompat::File_read_at_compressed_c(
+    fh, 0, buffer.data(), count, MPI_INT, MPI_STATUS_IGNORE);
+  CheckMPIFatal(ierr);
+
+  if (!std::equal(buffer.data(), buffer.data() + count, expected.data()))
+    {
+      std::cerr << "COMPRESSED READ WAS INVALID" << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  // a wrong count is detected from the header
+  ierr = BigMPICompat::File_read_at_compressed_c(
+    fh, 0, buffer.data(), count - 1, MPI_INT, MPI_STATUS_IGNORE);
+  if (ierr != MPI_ERR_COUNT)
+    {
+      std::cerr << "WRONG COUNT WAS NOT DETECTED" << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  ierr = MPI_File_close(&fh);
+  CheckMPIFatal(ierr);
+
+  if (myid == 0)
+    std::cout << "TEST file_compressed: OK" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int myid, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  assert(ranks >= 2);
+
+  test_codec();
+  test_send_recv_compressed();
+  test_file_compressed();
+
+  MPI_Finalize();
+  return 0;
+}
@@ -51,15 +51,71 @@ test_create_data_type(const std::uint64_t n_bytes, int myrank)
     std::cout << "OK" << std::endl;
 }
 
+void
+test_strategies()
+{
+  const std::uint64_t count = large_count(1, 3);
+
+  LargeBuffer<short> sendbuf(count);
+  LargeBuffer<short> recvbuf(count);
+  sendbuf[0]         = 1;
+  sendbuf[count / 2] = 2;
+  sendbuf[count - 1] = 3;
+
+  std::vector<BigMPICompat::TypeCost> costs;
+  int                                 ierr =
+    BigMPICompat::Type_benchmark_strategies(
+      sendbuf.data(), recvbuf.data(), count, MPI_SHORT, costs);
+  CheckMPIFatal(ierr);
+
+  if (costs.size() != 5 || recvbuf[0] != 1 || recvbuf[count / 2] != 2 ||
+      recvbuf[count - 1] != 3)
+    {
+      std::cerr << "TYPE STRATEGY BENCHMARK WAS INVALID" << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+  for (const BigMPICompat::TypeCost &cost : costs)
+    std::cout << "Strategy " << static_cast<int>(cost.strategy)
+              << ": n_blocks=" << cost.n_blocks
+              << " n_datatypes=" << cost.n_datatypes
+              << " construction=" << cost.construction_seconds
+              << "s transfer=" << cost.transfer_seconds << "s" << std::endl;
+
+  // the global strategy is used by all functions
+  BigMPICompat::Type_set_strategy(BigMPICompat::TypeStrategy::hindexed);
+  MPI_Datatype bigtype;
+  ierr = BigMPICompat::Type_contiguous_c(count, MPI_SHORT, &bigtype);
+  CheckMPIFatal(ierr);
+  BigMPICompat::Type_set_strategy(BigMPICompat::TypeStrategy::standard);
+
+  int n_integers, n_addresses, n_datatypes, combiner;
+  ierr = MPI_Type_get_envelope(
+    bigtype, &n_integers, &n_addresses, &n_datatypes, &combiner);
+  CheckMPIFatal(ierr);
+  MPI_Count size;
+  ierr = MPI_Type_size_x(bigtype, &size);
+  CheckMPIFatal(ierr);
+  if (combiner != MPI_COMBINER_HINDEXED ||
+      size != MPI_Count(count * sizeof(short)))
+    {
+      std::cerr << "GLOBAL TYPE STRATEGY WAS IGNORED" << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+  MPI_Type_free(&bigtype);
+
+  std::cout << "TEST type strategies: OK" << std::endl;
+}
+
 int
 main(int argc, char *argv[])
 {
   MPI_Init(&argc, &argv);
 
-  test_create_data_type((1ULL << 31) - 1, 0);
-  test_create_data_type(1ULL << 31, 0);
-  test_create_data_type(1ULL << 32, 0);
-  test_create_data_type(1ULL << 33, 0);
+  test_create_data_type(large_count(1, -1), 0);
+  test_create_data_type(large_count(1), 0);
+  test_create_data_type(large_count(2), 0);
+  test_create_data_type(large_count(4), 0);
+  test_strategies();
 
   MPI_Finalize();
   return 0;
@@ -0,0 +1,225 @@
+#include <big_mpi_compat.h>
+
+#include "common.h"
+
+#include <memory>
+
+
+/**
+ * An Iallgather_c() that is in flight on @p comm while another collective
+ * runs on the same communicator, to check that their messages do not match
+ * each other.
+ */
+class BackgroundAllgather
+{
+public:
+  explicit BackgroundAllgather(MPI_Comm comm)
+    : count(large_count(1, 3))
+    , sendbuf(count)
+  {
+    MPI_Comm_rank(comm, &myid);
+    MPI_Comm_size(comm, &ranks);
+    recvbuf.reset(new LargeBuffer<char>(count * ranks));
+
+    std::fill(sendbuf.data(), sendbuf.data() + count, 'x' + myid);
+    int ierr = BigMPICompat::Iallgather_c(sendbuf.data(),
+                                          count,
+                                          MPI_CHAR,
+                                          recvbuf->data(),
+                                          count,
+                                          MPI_CHAR,
+                                          comm,
+                                          &request);
+    CheckMPIFatal(ierr);
+
+    // let the ring run ahead on all processes but the root, so that its
+    // later messages arrive there during the other collective
+    const double start = MPI_Wtime();
+    int          flag  = 0;
+    while (myid != 0 && !flag && MPI_Wtime() - start < 0.1)
+      {
+        ierr = BigMPICompat::Test(&request, &flag, MPI_STATUS_IGNORE);
+        CheckMPIFatal(ierr);
+      }
+  }
+
+  void
+  finish()
+  {
+    const int ierr = BigMPICompat::Wait(&request, MPI_STATUS_IGNORE);
+    CheckMPIFatal(ierr);
+    for (int i = 0; i < ranks; ++i)
+      if (!std::all_of(recvbuf->data() + i * count,
+                       recvbuf->data() + (i + 1) * count,
+                       [&](const char c) { return c == 'x' + i; }))
+        {
+          std::cerr << "MPI BACKGROUND IALLGATHER WAS INVALID on rank "
+                    << myid << std::endl;
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+  }
+
+private:
+  int                                myid, ranks;
+  std::uint64_t                      count;
+  LargeBuffer<char>                  sendbuf;
+  std::unique_ptr<LargeBuffer<char>> recvbuf;
+  MPI_Request                        request;
+};
+
+
+void
+test_gatherv(const BigMPICompat::CollectiveAlgorithm algorithm,
+             const bool                              overlapping)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid, ranks;
+  MPI_Comm_rank(comm, &myid);
+  MPI_Comm_size(comm, &ranks);
+
+  // every rank sends more than 2^31 elements, which the root stores in
+  // reverse order of the ranks
+  std::vector<MPI_Count> counts(ranks);
+  std::vector<MPI_Aint>  displs(ranks);
+  MPI_Count              total = 0;
+  for (int i = ranks - 1; i >= 0; --i)
+    {
+      counts[i] = large_count(1, i + 1);
+      displs[i] = total;
+      total += counts[i];
+    }
+
+  LargeBuffer<char> sendbuf(counts[myid]);
+  sendbuf[0]                = 'a' + myid;
+  sendbuf[counts[myid] - 1] = 'A' + myid;
+
+  std::unique_ptr<BackgroundAllgather> background;
+  if (overlapping)
+    background.reset(new BackgroundAllgather(comm));
+
+  std::vector<char> recvbuf((myid == 0) ? total : 0, '?');
+  int               ierr = BigMPICompat::Gatherv_c(sendbuf.data(),
+                                     counts[myid],
+                                     MPI_CHAR,
+                                     recvbuf.data(),
+                                     counts.data(),
+                                     displs.data(),
+                                     MPI_CHAR,
+                                     0 /* root */,
+                                     comm,
+                                     algorithm);
+  CheckMPIFatal(ierr);
+
+  if (myid == 0)
+    for (int i = 0; i < ranks; ++i)
+      if (recvbuf[displs[i]] != 'a' + i || recvbuf[displs[i] + 1] != 0 ||
+          recvbuf[displs[i] + counts[i] - 1] != 'A' + i)
+        {
+          std::cerr << "MPI GATHERV WAS INVALID for rank " << i << std::endl;
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+  if (overlapping)
+    background->finish();
+
+  if (myid == 0)
+    std::cout << "TEST gatherv "
+              << ((algorithm == BigMPICompat::CollectiveAlgorithm::direct) ?
+                    "direct" :
+                    "node_aggregated")
+              << (overlapping ? " with iallgather" : "") << ": OK"
+              << std::endl;
+}
+
+void
+test_scatterv(const BigMPICompat::CollectiveAlgorithm algorithm,
+              const bool                              overlapping)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid, ranks;
+  MPI_Comm_rank(comm, &myid);
+  MPI_Comm_size(comm, &ranks);
+
+  std::vector<MPI_Count> counts(ranks);
+  std::vector<MPI_Aint>  displs(ranks);
+  MPI_Count              total = 0;
+  for (int i = ranks - 1; i >= 0; --i)
+    {
+      counts[i] = large_count(1, i + 1);
+      displs[i] = total;
+      total += counts[i];
+    }
+
+  LargeBuffer<char> sendbuf((myid == 0) ? total : 0);
+  if (myid == 0)
+    for (int i = 0; i < ranks; ++i)
+      {
+        sendbuf[displs[i]]                 = 'a' + i;
+        sendbuf[displs[i] + counts[i] - 1] = 'A' + i;
+      }
+
+  std::unique_ptr<BackgroundAllgather> background;
+  if (overlapping)
+    background.reset(new BackgroundAllgather(comm));
+
+  std::vector<char> recvbuf(counts[myid], '?');
+  int               ierr = BigMPICompat::Scatterv_c(sendbuf.data(),
+                                      counts.data(),
+                                      displs.data(),
+                                      MPI_CHAR,
+                                      recvbuf.data(),
+                                      counts[myid],
+                                      MPI_CHAR,
+                                      0 /* root */,
+                                      comm,
+                                      algorithm);
+  CheckMPIFatal(ierr);
+
+  if (recvbuf[0] != 'a' + myid || recvbuf[1] != 0 ||
+      recvbuf[counts[myid] - 1] != 'A' + myid)
+    {
+      std::cerr << "MPI SCATTERV WAS INVALID on rank " << myid << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+  if (overlapping)
+    background->finish();
+
+  if (myid == 0)
+    std::cout << "TEST scatterv "
+              << ((algorithm == BigMPICompat::CollectiveAlgorithm::direct) ?
+                    "direct" :
+                    "node_aggregated")
+              << (overlapping ? " with iallgather" : "") << ": OK"
+              << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int myid, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  assert(ranks >= 2);
+
+  for (const bool overlapping : {false, true})
+    {
+      test_gatherv(BigMPICompat::CollectiveAlgorithm::direct, overlapping);
+      test_gatherv(BigMPICompat::CollectiveAlgorithm::node_aggregated,
+                   overlapping);
+      test_scatterv(BigMPICompat::CollectiveAlgorithm::direct, overlapping);
+      test_scatterv(BigMPICompat::CollectiveAlgorithm::node_aggregated,
+                    overlapping);
+    }
+
+  // the messages between the nodes must not depend on the strategy, even
+  // though it changes the type signature
+  BigMPICompat::Type_set_strategy(BigMPICompat::TypeStrategy::bytes);
+  test_gatherv(BigMPICompat::CollectiveAlgorithm::node_aggregated, false);
+  test_scatterv(BigMPICompat::CollectiveAlgorithm::node_aggregated, false);
+  BigMPICompat::Type_set_strategy(BigMPICompat::TypeStrategy::standard);
+
+  MPI_Finalize();
+  return 0;
+}
@@ -9,7 +9,6 @@ test_read_write(const std::uint64_t n_bytes, const std::string &command)
   int myid, ranks;
   MPI_Comm_rank(MPI_COMM_WORLD, &myid);
   MPI_Comm_size(MPI_COMM_WORLD, &ranks);
-  assert(ranks == 2);
 
   std::uint64_t offset = myid * n_bytes;
 
@@ -75,14 +74,41 @@ test_read_write(const std::uint64_t n_bytes, const std::string &command)
 
   if (myid == 0)
     {
-      int result =
-        system("md5sum io.data | grep 4c1fe47ac9c80d7af0ea289c90e13132");
-      if (result == 0)
-        std::cout << "io: " << command << " md5sum: OK" << std::endl;
+      // Compare the checksum of the file with the one of the expected
+      // content, streaming through both in pieces of at most 64 MiB.
+      MPI_Offset file_size;
+      ierr = MPI_File_get_size(fh, &file_size);
+      CheckMPIFatal(ierr);
+
+      const std::uint64_t chunk_size = 1ULL << 26;
+      std::vector<char>   chunk(std::min(chunk_size, n_bytes));
+      StreamingChecksum   expected, actual;
+      for (int rank = 0; rank < ranks; ++rank)
+        for (std::uint64_t pos = 0; pos < n_bytes; pos += chunk_size)
+          {
+            const std::uint64_t n = std::min(chunk_size, n_bytes - pos);
+            std::fill(chunk.begin(), chunk.begin() + n, '?');
+            if (pos == 0)
+              chunk[0] = 'A' + rank;
+            expected.update(chunk.data(), n);
+
+            ierr = MPI_File_read_at(fh,
+                                    rank * n_bytes + pos,
+                                    chunk.data(),
+                                    n,
+                                    MPI_CHAR,
+                                    MPI_STATUS_IGNORE);
+            CheckMPIFatal(ierr);
+            actual.update(chunk.data(), n);
+          }
+
+      if (static_cast<std::uint64_t>(file_size) == ranks * n_bytes &&
+          actual.value() == expected.value())
+        std::cout << "io: " << command << " checksum: OK" << std::endl;
       else
         {
-          std::cerr << "io: " << command
-                    << " md5sum FAILED - result: " << result << std::endl;
+          std::cerr << "io: " << command << " checksum FAILED - size "
+                    << file_size << std::endl;
           MPI_Abort(MPI_COMM_WORLD, 1);
         }
     }
@@ -97,8 +123,8 @@ main(int argc, char *argv[])
 {
   MPI_Init(&argc, &argv);
 
-  test_read_write((1ULL << 32) + 2, "at");
-  test_read_write((1ULL << 32) + 2, "at_all");
+  test_read_write(large_count(2, 2), "at");
+  test_read_write(large_count(2, 2), "at_all");
 
   MPI_Finalize();
   return 0;
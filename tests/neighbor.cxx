@@ -0,0 +1,187 @@
+#include <big_mpi_compat.h>
+
+#include "common.h"
+
+
+/**
+ * Create a ring as distributed graph, where every rank receives from its
+ * left and right neighbor and sends to its right and left neighbor (in
+ * this order, so that the messages also match in order with two ranks).
+ */
+MPI_Comm
+create_ring(std::vector<int> &sources, std::vector<int> &destinations)
+{
+  int myid, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  const int left  = (myid + ranks - 1) % ranks;
+  const int right = (myid + 1) % ranks;
+  sources         = {left, right};
+  destinations    = {right, left};
+
+  MPI_Comm ring;
+  int      ierr = MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD,
+                                            2,
+                                            sources.data(),
+                                            MPI_UNWEIGHTED,
+                                            2,
+                                            destinations.data(),
+                                            MPI_UNWEIGHTED,
+                                            MPI_INFO_NULL,
+                                            0,
+                                            &ring);
+  CheckMPIFatal(ierr);
+  return ring;
+}
+
+void
+test_alltoallv(const bool nonblocking)
+{
+  std::vector<int> sources, destinations;
+  MPI_Comm         ring = create_ring(sources, destinations);
+  int              myid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+
+  // the block to the right neighbor fits into an int, the one to the left
+  // does not, and the total is larger than 2^31 in any case
+  const MPI_Count              small      = large_count(1, -2);
+  const MPI_Count              large      = large_count(1, 3);
+  const std::vector<MPI_Count> sendcounts = {small, large};
+  const std::vector<MPI_Aint>  sdispls    = {0, sendcounts[0]};
+  const std::vector<MPI_Count> recvcounts = {sendcounts[0], sendcounts[1]};
+  const std::vector<MPI_Aint>  rdispls    = {sendcounts[1], 0};
+
+  LargeBuffer<char> sendbuf(sendcounts[0] + sendcounts[1]);
+  for (unsigned int k = 0; k < 2; ++k)
+    {
+      sendbuf[sdispls[k]]                     = 'a' + myid;
+      sendbuf[sdispls[k] + sendcounts[k] - 1] = '0' + k;
+    }
+
+  std::vector<char> recvbuf(recvcounts[0] + recvcounts[1], '?');
+  int               ierr;
+  if (nonblocking)
+    {
+      MPI_Request request;
+      ierr = BigMPICompat::Ineighbor_alltoallv_c(sendbuf.data(),
+                                                 sendcounts.data(),
+                                                 sdispls.data(),
+                                                 MPI_CHAR,
+                                                 recvbuf.data(),
+                                                 recvcounts.data(),
+                                                 rdispls.data(),
+                                                 MPI_CHAR,
+                                                 ring,
+                                                 &request);
+      CheckMPIFatal(ierr);
+      ierr = BigMPICompat::Wait(&request, MPI_STATUS_IGNORE);
+    }
+  else
+    ierr = BigMPICompat::Neighbor_alltoallv_c(sendbuf.data(),
+                                              sendcounts.data(),
+                                              sdispls.data(),
+                                              MPI_CHAR,
+                                              recvbuf.data(),
+                                              recvcounts.data(),
+                                              rdispls.data(),
+                                              MPI_CHAR,
+                                              ring);
+  CheckMPIFatal(ierr);
+
+  for (unsigned int k = 0; k < 2; ++k)
+    if (recvbuf[rdispls[k]] != 'a' + sources[k] ||
+        recvbuf[rdispls[k] + 1] != 0 ||
+        recvbuf[rdispls[k] + recvcounts[k] - 1] != char('0' + k))
+      {
+        std::cerr << "MPI NEIGHBOR_ALLTOALLV WAS INVALID for neighbor " << k
+                  << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+
+  MPI_Comm_free(&ring);
+
+  if (myid == 0)
+    std::cout << "TEST " << (nonblocking ? "ineighbor" : "neighbor")
+              << "_alltoallv: OK" << std::endl;
+}
+
+void
+test_allgatherv(const bool nonblocking)
+{
+  std::vector<int> sources, destinations;
+  MPI_Comm         ring = create_ring(sources, destinations);
+  int              myid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+
+  const MPI_Count              sendcount  = large_count(1, 3);
+  const std::vector<MPI_Count> recvcounts = {sendcount, sendcount};
+  const std::vector<MPI_Aint>  displs     = {sendcount, 0};
+
+  LargeBuffer<char> sendbuf(sendcount);
+  sendbuf[0]             = 'a' + myid;
+  sendbuf[sendcount - 1] = 'A' + myid;
+
+  std::vector<char> recvbuf(2 * sendcount, '?');
+  int               ierr;
+  if (nonblocking)
+    {
+      MPI_Request request;
+      ierr = BigMPICompat::Ineighbor_allgatherv_c(sendbuf.data(),
+                                                  sendcount,
+                                                  MPI_CHAR,
+                                                  recvbuf.data(),
+                                                  recvcounts.data(),
+                                                  displs.data(),
+                                                  MPI_CHAR,
+                                                  ring,
+                                                  &request);
+      CheckMPIFatal(ierr);
+      ierr = BigMPICompat::Wait(&request, MPI_STATUS_IGNORE);
+    }
+  else
+    ierr = BigMPICompat::Neighbor_allgatherv_c(sendbuf.data(),
+                                               sendcount,
+                                               MPI_CHAR,
+                                               recvbuf.data(),
+                                               recvcounts.data(),
+                                               displs.data(),
+                                               MPI_CHAR,
+                                               ring);
+  CheckMPIFatal(ierr);
+
+  for (unsigned int k = 0; k < 2; ++k)
+    if (recvbuf[displs[k]] != 'a' + sources[k] || recvbuf[displs[k] + 1] != 0 ||
+        recvbuf[displs[k] + sendcount - 1] != 'A' + sources[k])
+      {
+        std::cerr << "MPI NEIGHBOR_ALLGATHERV WAS INVALID for neighbor " << k
+                  << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+
+  MPI_Comm_free(&ring);
+
+  if (myid == 0)
+    std::cout << "TEST " << (nonblocking ? "ineighbor" : "neighbor")
+              << "_allgatherv: OK" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int myid, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  assert(ranks >= 2);
+
+  test_alltoallv(false);
+  test_alltoallv(true);
+  test_allgatherv(false);
+  test_allgatherv(true);
+
+  MPI_Finalize();
+  return 0;
+}
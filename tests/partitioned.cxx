@@ -0,0 +1,229 @@
+#include <big_mpi_compat.h>
+
+#include "common.h"
+
+#include <chrono>
+#include <thread>
+
+
+void
+test_partitioned()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid;
+  MPI_Comm_rank(comm, &myid);
+
+  // every partition is larger than 2^31 elements
+  const int           partitions = 3;
+  const std::uint64_t count      = large_count(1, 3);
+
+  LargeBuffer<char> buffer((myid < 2) ? partitions * count : 0);
+  MPI_Request       request = MPI_REQUEST_NULL;
+  int               ierr    = MPI_SUCCESS;
+  if (myid == 0)
+    ierr = BigMPICompat::Psend_init_c(buffer.data(),
+                                      partitions,
+                                      count,
+                                      MPI_CHAR,
+                                      1 /* dest */,
+                                      10 /* tag */,
+                                      comm,
+                                      MPI_INFO_NULL,
+                                      &request);
+  else if (myid == 1)
+    ierr = BigMPICompat::Precv_init_c(buffer.data(),
+                                      partitions,
+                                      count,
+                                      MPI_CHAR,
+                                      0 /* source */,
+                                      10 /* tag */,
+                                      comm,
+                                      MPI_INFO_NULL,
+                                      &request);
+  CheckMPIFatal(ierr);
+
+  // use the persistent request twice
+  for (int round = 0; round < 2; ++round)
+    {
+      if (myid == 0)
+        {
+          ierr = BigMPICompat::Start(&request);
+          CheckMPIFatal(ierr);
+
+          // the partitions become ready in reverse order, like produced by
+          // threads that finish at different times
+          for (int i = partitions - 1; i >= 0; --i)
+            {
+              buffer[i * count]           = 'a' + i + round;
+              buffer[(i + 1) * count - 1] = 'A' + i + round;
+              if (i == 0)
+                ierr = BigMPICompat::Pready(i, request);
+              else if (i == 1)
+                {
+                  const int list[] = {1};
+                  ierr = BigMPICompat::Pready_list(1, list, request);
+                }
+              else
+                ierr = BigMPICompat::Pready_range(i, i, request);
+              CheckMPIFatal(ierr);
+            }
+
+          ierr = BigMPICompat::Wait(&request, MPI_STATUS_IGNORE);
+          CheckMPIFatal(ierr);
+        }
+      else if (myid == 1)
+        {
+          ierr = BigMPICompat::Start(&request);
+          CheckMPIFatal(ierr);
+
+          // wait for the last partition first, which is sent first
+          int flag = 0;
+          while (!flag)
+            {
+              ierr = BigMPICompat::Parrived(request, partitions - 1, &flag);
+              CheckMPIFatal(ierr);
+            }
+          if (buffer[partitions * count - 1] != 'A' + partitions - 1 + round)
+            {
+              std::cerr << "PARTITION ARRIVED TOO EARLY" << std::endl;
+              MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+
+          ierr = BigMPICompat::Wait(&request, MPI_STATUS_IGNORE);
+          CheckMPIFatal(ierr);
+
+          for (int i = 0; i < partitions; ++i)
+            {
+              ierr = BigMPICompat::Parrived(request, i, &flag);
+              CheckMPIFatal(ierr);
+              if (!flag || buffer[i * count] != 'a' + i + round ||
+                  buffer[i * count + 1] != 0 ||
+                  buffer[(i + 1) * count - 1] != 'A' + i + round)
+                {
+                  std::cerr << "MPI PARTITIONED RECEIVE WAS INVALID for "
+                            << "partition " << i << std::endl;
+                  MPI_Abort(MPI_COMM_WORLD, 1);
+                }
+            }
+        }
+      MPI_Barrier(comm);
+    }
+
+  if (myid < 2)
+    {
+      ierr = BigMPICompat::Request_free(&request);
+      CheckMPIFatal(ierr);
+    }
+
+  if (myid == 0)
+    std::cout << "TEST partitioned: OK" << std::endl;
+}
+
+void
+test_partitioned_threads()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid;
+  MPI_Comm_rank(comm, &myid);
+
+  const int           partitions = 4;
+  const std::uint64_t count      = large_count(1, 3);
+
+  LargeBuffer<char> buffer((myid < 2) ? partitions * count : 0);
+  MPI_Request       request = MPI_REQUEST_NULL;
+  int               ierr    = MPI_SUCCESS;
+  if (myid == 0)
+    {
+      ierr = BigMPICompat::Psend_init_c(buffer.data(),
+                                        partitions,
+                                        count,
+                                        MPI_CHAR,
+                                        1 /* dest */,
+                                        20 /* tag */,
+                                        comm,
+                                        MPI_INFO_NULL,
+                                        &request);
+      CheckMPIFatal(ierr);
+      ierr = BigMPICompat::Start(&request);
+      CheckMPIFatal(ierr);
+
+      // every partition is produced by its own thread, which marks it
+      // ready while the main thread already waits for the request
+      std::vector<std::thread> producers;
+      for (int i = 0; i < partitions; ++i)
+        producers.emplace_back([&buffer, &request, count, i]() {
+          std::this_thread::sleep_for(std::chrono::milliseconds(50 * (i + 1)));
+          buffer[i * count]           = 'a' + i;
+          buffer[(i + 1) * count - 1] = 'A' + i;
+          const int ierr              = BigMPICompat::Pready(i, request);
+          CheckMPIFatal(ierr);
+        });
+
+      ierr = BigMPICompat::Wait(&request, MPI_STATUS_IGNORE);
+      CheckMPIFatal(ierr);
+
+      // all partitions left the buffer, so it may be reused now
+      for (int i = 0; i < partitions; ++i)
+        buffer[i * count] = '?';
+      for (std::thread &producer : producers)
+        producer.join();
+    }
+  else if (myid == 1)
+    {
+      ierr = BigMPICompat::Precv_init_c(buffer.data(),
+                                        partitions,
+                                        count,
+                                        MPI_CHAR,
+                                        0 /* source */,
+                                        20 /* tag */,
+                                        comm,
+                                        MPI_INFO_NULL,
+                                        &request);
+      CheckMPIFatal(ierr);
+      ierr = BigMPICompat::Start(&request);
+      CheckMPIFatal(ierr);
+      ierr = BigMPICompat::Wait(&request, MPI_STATUS_IGNORE);
+      CheckMPIFatal(ierr);
+
+      for (int i = 0; i < partitions; ++i)
+        if (buffer[i * count] != 'a' + i ||
+            buffer[(i + 1) * count - 1] != 'A' + i)
+          {
+            std::cerr << "MPI PARTITIONED RECEIVE FROM THREADS WAS INVALID "
+                      << "for partition " << i << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+          }
+    }
+
+  if (myid < 2)
+    {
+      ierr = BigMPICompat::Request_free(&request);
+      CheckMPIFatal(ierr);
+    }
+
+  if (myid == 0)
+    std::cout << "TEST partitioned threads: OK" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+
+  int myid, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  assert(ranks >= 2);
+
+  test_partitioned();
+  if (provided == MPI_THREAD_MULTIPLE)
+    test_partitioned_threads();
+  else if (myid == 0)
+    std::cout << "TEST partitioned threads: skipped, MPI_THREAD_MULTIPLE "
+              << "is not supported" << std::endl;
+
+  MPI_Finalize();
+  return 0;
+}
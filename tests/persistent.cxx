@@ -0,0 +1,140 @@
+#include <big_mpi_compat.h>
+
+#include "common.h"
+
+
+void
+test_send_recv_init()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid;
+  MPI_Comm_rank(comm, &myid);
+
+  const std::uint64_t count   = large_count(2, 5);
+  const unsigned int  n_steps = 3;
+
+  std::vector<short> buffer(count, 42);
+  MPI_Request        request = MPI_REQUEST_NULL;
+  int                ierr    = MPI_SUCCESS;
+
+  if (myid == 0)
+    ierr = BigMPICompat::Send_init_c(buffer.data(),
+                                     count,
+                                     MPI_SHORT,
+                                     1 /* dest */,
+                                     0 /* tag */,
+                                     comm,
+                                     &request);
+  else if (myid == 1)
+    ierr = BigMPICompat::Recv_init_c(buffer.data(),
+                                     count,
+                                     MPI_SHORT,
+                                     0 /* src */,
+                                     0 /* tag */,
+                                     comm,
+                                     &request);
+  CheckMPIFatal(ierr);
+
+  for (unsigned int step = 0; step < n_steps; ++step)
+    {
+      if (myid == 0)
+        {
+          buffer[0]         = step;
+          buffer[count - 1] = 2 * step + 1;
+        }
+
+      if (myid <= 1)
+        {
+          ierr = BigMPICompat::Start(&request);
+          CheckMPIFatal(ierr);
+          ierr = BigMPICompat::Wait(&request, MPI_STATUS_IGNORE);
+          CheckMPIFatal(ierr);
+        }
+
+      if (myid == 1 && (buffer[0] != short(step) ||
+                        buffer[count - 1] != short(2 * step + 1)))
+        {
+          std::cerr << "MPI PERSISTENT RECEIVE WAS INVALID in step " << step
+                    << ": " << buffer[0] << ' ' << buffer[count - 1]
+                    << std::endl;
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+  if (myid <= 1)
+    {
+      ierr = BigMPICompat::Request_free(&request);
+      CheckMPIFatal(ierr);
+    }
+
+  if (myid == 0)
+    std::cout << "TEST send_recv_init: OK" << std::endl;
+}
+
+void
+test_bcast_init()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid;
+  MPI_Comm_rank(comm, &myid);
+
+  const std::uint64_t count   = large_count(2, 5);
+  const unsigned int  n_steps = 3;
+
+  std::vector<short> buffer(count, 42);
+  MPI_Request        request;
+  int                ierr = BigMPICompat::Bcast_init_c(buffer.data(),
+                                            count,
+                                            MPI_SHORT,
+                                            0 /* root */,
+                                            comm,
+                                            MPI_INFO_NULL,
+                                            &request);
+  CheckMPIFatal(ierr);
+
+  for (unsigned int step = 0; step < n_steps; ++step)
+    {
+      if (myid == 0)
+        {
+          buffer[1]         = step;
+          buffer[count - 1] = 2 * step + 1;
+        }
+
+      ierr = BigMPICompat::Start(&request);
+      CheckMPIFatal(ierr);
+      ierr = BigMPICompat::Wait(&request, MPI_STATUS_IGNORE);
+      CheckMPIFatal(ierr);
+
+      if (buffer[1] != short(step) || buffer[count - 1] != short(2 * step + 1))
+        {
+          std::cerr << "MPI PERSISTENT BCAST WAS INVALID in step " << step
+                    << ": " << buffer[1] << ' ' << buffer[count - 1]
+                    << std::endl;
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+  ierr = BigMPICompat::Request_free(&request);
+  CheckMPIFatal(ierr);
+
+  if (myid == 0)
+    std::cout << "TEST bcast_init: OK" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int myid, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  assert(ranks >= 2);
+
+  test_send_recv_init();
+  test_bcast_init();
+
+  MPI_Finalize();
+  return 0;
+}
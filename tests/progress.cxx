@@ -0,0 +1,206 @@
+#define MPI_COMPAT_WITH_PROGRESS_THREAD
+#include <big_mpi_compat.h>
+
+#include "common.h"
+
+#include <chrono>
+#include <thread>
+
+
+void
+test_isend_irecv()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid;
+  MPI_Comm_rank(comm, &myid);
+
+  const std::uint64_t count = large_count(2, 5);
+
+  int ierr = BigMPICompat::Progress_start();
+  CheckMPIFatal(ierr);
+
+  std::vector<short> buffer(count, 42);
+  MPI_Request        request = MPI_REQUEST_NULL;
+  if (myid == 0)
+    {
+      buffer[0]         = 0;
+      buffer[count - 1] = 2;
+      ierr              = BigMPICompat::Isend_c(buffer.data(),
+                                   count,
+                                   MPI_SHORT,
+                                   1 /* dest */,
+                                   0 /* tag */,
+                                   comm,
+                                   &request);
+      CheckMPIFatal(ierr);
+    }
+  else if (myid == 1)
+    {
+      ierr = BigMPICompat::Irecv_c(buffer.data(),
+                                   count,
+                                   MPI_SHORT,
+                                   0 /* src */,
+                                   0 /* tag */,
+                                   comm,
+                                   &request);
+      CheckMPIFatal(ierr);
+    }
+
+  // Compute without calling MPI while the progress thread moves the data:
+  // the receiver watches the last element arrive, the sender just waits.
+  // Without the thread, nothing would match the large message.
+  const auto deadline =
+    std::chrono::steady_clock::now() + std::chrono::seconds(60);
+  if (myid == 1)
+    {
+      const volatile short *last = buffer.data() + count - 1;
+      while (*last != 2 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+
+  // a single check, which cannot move a large message by itself
+  int flag = 0;
+  ierr     = BigMPICompat::Test(&request, &flag, MPI_STATUS_IGNORE);
+  CheckMPIFatal(ierr);
+  if (myid < 2 && !flag)
+    {
+      std::cerr << "REQUEST DID NOT COMPLETE IN THE BACKGROUND on rank "
+                << myid << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+  ierr = BigMPICompat::Wait(&request, MPI_STATUS_IGNORE);
+  CheckMPIFatal(ierr);
+
+  if (myid == 1 && (buffer[0] != 0 || buffer[count - 1] != 2))
+    {
+      std::cerr << "MPI IRECV WAS INVALID:" << buffer[0] << ' '
+                << buffer[count - 1] << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  ierr = BigMPICompat::Progress_stop();
+  CheckMPIFatal(ierr);
+
+  if (myid == 0)
+    std::cout << "TEST isend_irecv: OK" << std::endl;
+}
+
+void
+test_ibcast()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid;
+  MPI_Comm_rank(comm, &myid);
+
+  const std::uint64_t count = large_count(2, 5);
+
+  // This time the thread is stopped by MPI_Finalize().
+  int ierr = BigMPICompat::Progress_start();
+  CheckMPIFatal(ierr);
+
+  std::vector<short> buffer(count, 42);
+  if (myid == 0)
+    {
+      buffer[1]         = 1;
+      buffer[count - 1] = 99;
+    }
+
+  MPI_Request request;
+  ierr = BigMPICompat::Ibcast_c(
+    buffer.data(), count, MPI_SHORT, 0 /* root */, comm, &request);
+  CheckMPIFatal(ierr);
+  ierr = BigMPICompat::Wait(&request, MPI_STATUS_IGNORE);
+  CheckMPIFatal(ierr);
+
+  if (buffer[1] != 1 || buffer[count - 1] != 99)
+    {
+      std::cerr << "MPI IBCAST WAS INVALID:" << buffer[1] << ' '
+                << buffer[count - 1] << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  if (myid == 0)
+    std::cout << "TEST ibcast: OK" << std::endl;
+}
+
+void
+test_iallgather()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid, ranks;
+  MPI_Comm_rank(comm, &myid);
+  MPI_Comm_size(comm, &ranks);
+
+  const std::uint64_t count = large_count(1, 3);
+
+  int ierr = BigMPICompat::Progress_start();
+  CheckMPIFatal(ierr);
+
+  LargeBuffer<char> buffer(count * ranks);
+  buffer[myid * count]           = 'a' + myid;
+  buffer[(myid + 1) * count - 1] = 'A' + myid;
+
+  MPI_Request request;
+  ierr = BigMPICompat::Iallgather_c(
+    MPI_IN_PLACE, 0, MPI_CHAR, buffer.data(), count, MPI_CHAR, comm, &request);
+  CheckMPIFatal(ierr);
+
+  // The thread has to advance the ring step by step without any calls into
+  // the library here, which is only visible as the blocks arrive.
+  const auto deadline =
+    std::chrono::steady_clock::now() + std::chrono::seconds(60);
+  const volatile char *data     = buffer.data();
+  bool                 complete = false;
+  while (!complete && std::chrono::steady_clock::now() < deadline)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      complete = true;
+      for (int i = 0; i < ranks; ++i)
+        if (data[i * count] != 'a' + i || data[(i + 1) * count - 1] != 'A' + i)
+          complete = false;
+    }
+  if (!complete)
+    {
+      std::cerr << "IALLGATHER DID NOT PROGRESS IN THE BACKGROUND on rank "
+                << myid << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  ierr = BigMPICompat::Wait(&request, MPI_STATUS_IGNORE);
+  CheckMPIFatal(ierr);
+  ierr = BigMPICompat::Progress_stop();
+  CheckMPIFatal(ierr);
+
+  if (myid == 0)
+    std::cout << "TEST iallgather: OK" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+
+  int myid, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  assert(ranks >= 2);
+
+  if (provided != MPI_THREAD_MULTIPLE)
+    {
+      if (myid == 0)
+        std::cout << "TEST progress: skipped, MPI_THREAD_MULTIPLE "
+                  << "is not supported" << std::endl;
+    }
+  else
+    {
+      test_isend_irecv();
+      test_iallgather();
+      test_ibcast();
+    }
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,124 @@
+#include <big_mpi_compat.h>
+
+#include "common.h"
+
+
+void
+test_read_bcast(const bool node_aggregated)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid;
+  MPI_Comm_rank(comm, &myid);
+
+  // more than 2^31 elements, which are not a multiple of the chunk size
+  const std::uint64_t count = large_count(2, 3);
+
+  // all ranks open the file, but rank 0 writes it before the others read
+  MPI_File fh;
+  int      ierr = MPI_File_open(comm,
+                           "read_bcast.data",
+                           MPI_MODE_CREATE | MPI_MODE_RDWR |
+                             MPI_MODE_DELETE_ON_CLOSE,
+                           MPI_INFO_NULL,
+                           &fh);
+  CheckMPIFatal(ierr);
+
+  if (myid == 0)
+    {
+      LargeBuffer<char> data(count);
+      data[0]         = 'a';
+      data[count / 2] = 'b';
+      data[count - 1] = 'c';
+      ierr            = BigMPICompat::File_write_at_c(
+        fh, 0, data.data(), count, MPI_CHAR, MPI_STATUS_IGNORE);
+      CheckMPIFatal(ierr);
+    }
+  ierr = MPI_File_sync(fh);
+  CheckMPIFatal(ierr);
+  MPI_Barrier(comm);
+  ierr = MPI_File_sync(fh);
+  CheckMPIFatal(ierr);
+
+  LargeBuffer<char> buffer(count);
+  if (node_aggregated)
+    ierr = BigMPICompat::File_read_bcast_c(
+      fh,
+      0,
+      buffer.data(),
+      count,
+      MPI_CHAR,
+      0 /* root */,
+      comm,
+      BigMPICompat::CollectiveAlgorithm::node_aggregated);
+  else
+    ierr = BigMPICompat::File_read_bcast_c((myid == 0) ? fh : MPI_FILE_NULL,
+                                           0,
+                                           buffer.data(),
+                                           count,
+                                           MPI_CHAR,
+                                           0 /* root */,
+                                           comm);
+  CheckMPIFatal(ierr);
+
+  if (buffer[0] != 'a' || buffer[1] != 0 || buffer[count / 2] != 'b' ||
+      buffer[count - 1] != 'c')
+    {
+      std::cerr << "MPI FILE READ BCAST WAS INVALID on rank " << myid
+                << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  // the same with a single copy of the data per node, twice to use the
+  // cached communicator of the node leaders as well
+  for (unsigned int repetition = 0; repetition < 2; ++repetition)
+    {
+      char   *shared = nullptr;
+      MPI_Win win;
+      ierr = BigMPICompat::File_read_bcast_shared_c(fh,
+                                                    0,
+                                                    count,
+                                                    MPI_CHAR,
+                                                    0 /* root */,
+                                                    comm,
+                                                    &shared,
+                                                    &win);
+      CheckMPIFatal(ierr);
+
+      if (shared[0] != 'a' || shared[1] != 0 || shared[count / 2] != 'b' ||
+          shared[count - 1] != 'c')
+        {
+          std::cerr << "MPI FILE READ BCAST SHARED WAS INVALID on rank "
+                    << myid << std::endl;
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+
+      ierr = MPI_Win_free(&win);
+      CheckMPIFatal(ierr);
+    }
+
+  ierr = MPI_File_close(&fh);
+  CheckMPIFatal(ierr);
+
+  if (myid == 0)
+    std::cout << "TEST read_bcast"
+              << (node_aggregated ? " node aggregated" : "") << ": OK"
+              << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int myid, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  assert(ranks >= 2);
+
+  test_read_bcast(false);
+  test_read_bcast(true);
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,201 @@
+#include <big_mpi_compat.h>
+
+#include "common.h"
+
+
+void
+test_put_get_accumulate()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid;
+  MPI_Comm_rank(comm, &myid);
+
+  const std::uint64_t count = large_count(2, 5);
+
+  // rank 1 exposes the window, rank 0 accesses it
+  unsigned char *window_data = nullptr;
+  MPI_Win        win;
+  int            ierr = BigMPICompat::Win_allocate_c(
+    (myid == 1) ? count : 0, 1, MPI_INFO_NULL, comm, &window_data, &win);
+  CheckMPIFatal(ierr);
+
+  if (myid == 1)
+    std::fill(window_data, window_data + count, 0);
+
+  std::vector<unsigned char> buffer;
+  if (myid == 0)
+    {
+      buffer.resize(count, 1);
+      buffer[count - 1] = 2;
+    }
+
+  ierr = MPI_Win_fence(0, win);
+  CheckMPIFatal(ierr);
+  if (myid == 0)
+    {
+      ierr = BigMPICompat::Put_c(buffer.data(),
+                                 count,
+                                 MPI_UNSIGNED_CHAR,
+                                 1 /* target */,
+                                 0 /* disp */,
+                                 count,
+                                 MPI_UNSIGNED_CHAR,
+                                 win);
+      CheckMPIFatal(ierr);
+    }
+  ierr = MPI_Win_fence(0, win);
+  CheckMPIFatal(ierr);
+
+  if (myid == 1 && (window_data[0] != 1 || window_data[count - 1] != 2))
+    {
+      std::cerr << "MPI PUT WAS INVALID:" << int(window_data[0]) << ' '
+                << int(window_data[count - 1]) << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  // make sure the check is done before the next access epoch starts
+  ierr = MPI_Win_fence(0, win);
+  CheckMPIFatal(ierr);
+
+  if (myid == 0)
+    {
+      ierr = BigMPICompat::Accumulate_c(buffer.data(),
+                                        count,
+                                        MPI_UNSIGNED_CHAR,
+                                        1 /* target */,
+                                        0 /* disp */,
+                                        count,
+                                        MPI_UNSIGNED_CHAR,
+                                        MPI_SUM,
+                                        win);
+      CheckMPIFatal(ierr);
+    }
+  ierr = MPI_Win_fence(0, win);
+  CheckMPIFatal(ierr);
+
+  if (myid == 1 && (window_data[0] != 2 || window_data[count - 2] != 2 ||
+                    window_data[count - 1] != 4))
+    {
+      std::cerr << "MPI ACCUMULATE WAS INVALID:" << int(window_data[0]) << ' '
+                << int(window_data[count - 1]) << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  // make sure the check is done before the next access epoch starts
+  ierr = MPI_Win_fence(0, win);
+  CheckMPIFatal(ierr);
+
+  if (myid == 0)
+    {
+      std::fill(buffer.begin(), buffer.end(), 42);
+      ierr = BigMPICompat::Get_c(buffer.data(),
+                                 count,
+                                 MPI_UNSIGNED_CHAR,
+                                 1 /* target */,
+                                 0 /* disp */,
+                                 count,
+                                 MPI_UNSIGNED_CHAR,
+                                 win);
+      CheckMPIFatal(ierr);
+    }
+  ierr = MPI_Win_fence(0, win);
+  CheckMPIFatal(ierr);
+
+  if (myid == 0 && (buffer[0] != 2 || buffer[count - 1] != 4))
+    {
+      std::cerr << "MPI GET WAS INVALID:" << int(buffer[0]) << ' '
+                << int(buffer[count - 1]) << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  if (myid == 0)
+    {
+      std::fill(buffer.begin(), buffer.end(), 42);
+      ierr = BigMPICompat::Get_accumulate_c(nullptr,
+                                            0,
+                                            MPI_UNSIGNED_CHAR,
+                                            buffer.data(),
+                                            count,
+                                            MPI_UNSIGNED_CHAR,
+                                            1 /* target */,
+                                            0 /* disp */,
+                                            count,
+                                            MPI_UNSIGNED_CHAR,
+                                            MPI_NO_OP,
+                                            win);
+      CheckMPIFatal(ierr);
+    }
+  ierr = MPI_Win_fence(0, win);
+  CheckMPIFatal(ierr);
+
+  if (myid == 0 && (buffer[0] != 2 || buffer[count - 1] != 4))
+    {
+      std::cerr << "MPI GET_ACCUMULATE WAS INVALID:" << int(buffer[0]) << ' '
+                << int(buffer[count - 1]) << std::endl;
+      MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+  ierr = MPI_Win_free(&win);
+  CheckMPIFatal(ierr);
+
+  if (myid == 0)
+    std::cout << "TEST put_get_accumulate: OK" << std::endl;
+}
+
+void
+test_disp_unit()
+{
+  // a displacement unit above the count limit is still a valid int
+  const MPI_Aint disp_unit =
+    std::min<MPI_Count>(BigMPICompat::mpi_max_int_count + 1,
+                        std::numeric_limits<int>::max());
+  char    value = 0;
+  MPI_Win win;
+  int     ierr = BigMPICompat::Win_create_c(
+    &value, 1, disp_unit, MPI_INFO_NULL, MPI_COMM_WORLD, &win);
+  CheckMPIFatal(ierr);
+  ierr = MPI_Win_free(&win);
+  CheckMPIFatal(ierr);
+
+#if MPI_VERSION < 4
+  // but one that does not fit into an int is rejected by the fallback
+  if (sizeof(MPI_Aint) > sizeof(int))
+    {
+      ierr = BigMPICompat::Win_create_c(
+        &value,
+        1,
+        MPI_Aint(std::numeric_limits<int>::max()) + 1,
+        MPI_INFO_NULL,
+        MPI_COMM_WORLD,
+        &win);
+      if (ierr != MPI_ERR_DISP)
+        {
+          std::cerr << "LARGE DISP_UNIT WAS NOT REJECTED" << std::endl;
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+#endif
+
+  int myid;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  if (myid == 0)
+    std::cout << "TEST disp_unit: OK" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int myid, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  assert(ranks >= 2);
+
+  test_put_get_accumulate();
+  test_disp_unit();
+
+  MPI_Finalize();
+  return 0;
+}
@@ -10,7 +10,7 @@ test_send_recv_manual()
   int      myid;
   MPI_Comm_rank(comm, &myid);
 
-  const std::uint64_t n_bytes = (1ULL << 32) + 5;
+  const std::uint64_t n_bytes = large_count(2, 5);
   MPI_Datatype        bigtype;
   int ierr = BigMPICompat::Type_contiguous_c(n_bytes, MPI_CHAR, &bigtype);
   CheckMPIFatal(ierr);
@@ -59,11 +59,11 @@ test_send_and_recv()
   int      myid;
   MPI_Comm_rank(comm, &myid);
 
-  const std::uint64_t count = (1ULL << 32) + 5;
+  const std::uint64_t count = large_count(2, 5);
 
   if (myid == 0)
     {
-      std::vector<short> buffer(count, 0);
+      LargeBuffer<short> buffer(count);
       buffer[count - 1] = 2;
       int ierr          = BigMPICompat::Send_c(
         buffer.data(), count, MPI_SHORT, 1 /* dest */, 0 /* tag */, comm);
@@ -102,7 +102,7 @@ main(int argc, char *argv[])
   MPI_Comm_rank(MPI_COMM_WORLD, &myid);
   MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
-  assert(ranks == 2);
+  assert(ranks >= 2);
 
   test_send_recv_manual();
   test_send_and_recv();
@@ -0,0 +1,218 @@
+#define MPI_COMPAT_WITH_TRACING
+#include <big_mpi_compat.h>
+
+#include "common.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+
+/**
+ * Return the contents of the file @p filename.
+ */
+std::string
+read_file(const char *filename)
+{
+  std::ifstream     file(filename);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+/**
+ * Return how often @p pattern occurs in @p text.
+ */
+unsigned int
+occurrences(const std::string &text, const std::string &pattern)
+{
+  unsigned int n = 0;
+  for (std::size_t pos = text.find(pattern); pos != std::string::npos;
+       pos          = text.find(pattern, pos + 1))
+    ++n;
+  return n;
+}
+
+void
+test_trace()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid, ranks;
+  MPI_Comm_rank(comm, &myid);
+  MPI_Comm_size(comm, &ranks);
+
+  int ierr = BigMPICompat::Trace_start("trace.json");
+  CheckMPIFatal(ierr);
+
+  const std::uint64_t count = large_count(1, 5);
+  LargeBuffer<char>   buffer(count);
+  if (myid == 0)
+    {
+      MPI_COMPAT_TRACE_SCOPE("send phase");
+      ierr = BigMPICompat::Send_checked_c(
+        buffer.data(), count, MPI_CHAR, 1 /* dest */, 0 /* tag */, comm);
+      CheckMPIFatal(ierr);
+    }
+  else if (myid == 1)
+    {
+      ierr = BigMPICompat::Recv_checked_c(buffer.data(),
+                                          count,
+                                          MPI_CHAR,
+                                          0 /* source */,
+                                          0 /* tag */,
+                                          comm,
+                                          MPI_STATUS_IGNORE);
+      CheckMPIFatal(ierr);
+    }
+  ierr = BigMPICompat::Bcast_c(buffer.data(), count, MPI_CHAR, 0, comm);
+  CheckMPIFatal(ierr);
+
+  // names are escaped and truncated in the JSON document
+  {
+    MPI_COMPAT_TRACE_SCOPE("a \"quoted\" \\ name");
+  }
+  const std::string long_name(500, 'x');
+  {
+    MPI_COMPAT_TRACE_SCOPE(long_name.c_str());
+  }
+
+  ierr = BigMPICompat::Trace_stop();
+  CheckMPIFatal(ierr);
+
+  if (myid == 0)
+    {
+      const std::string trace = read_file("trace.json");
+      if (trace.compare(0, 16, "{\"traceEvents\":[") != 0 ||
+          trace.compare(trace.size() - 4, 4, "\n]}\n") != 0 ||
+          occurrences(trace, "\"ph\":\"M\"") != unsigned(ranks) ||
+          occurrences(trace, "\"name\":\"Bcast_c\"") != unsigned(ranks) ||
+          occurrences(trace, "\"name\":\"send phase\"") != 1 ||
+          occurrences(trace, "\"name\":\"Send_checked_c\"") != 1 ||
+          occurrences(trace, "\"name\":\"Recv_checked_c\"") != 1 ||
+          occurrences(trace, "\"name\":\"chunk\"") < 4 ||
+          occurrences(trace, "\"name\":\"a \\\"quoted\\\" \\\\ name\"") !=
+            unsigned(ranks) ||
+          occurrences(trace,
+                      "\"name\":\"" + std::string(200, 'x') + "\",") !=
+            unsigned(ranks) ||
+          occurrences(trace, "\"name\":\"Type_contiguous_c\"") <
+            unsigned(ranks))
+        {
+          std::cerr << "TRACE WAS INVALID:\n" << trace << std::endl;
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+  if (myid == 0)
+    std::cout << "TEST trace: OK" << std::endl;
+}
+
+void
+test_trace_overflow()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid, ranks;
+  MPI_Comm_rank(comm, &myid);
+  MPI_Comm_size(comm, &ranks);
+
+  // only the last three events of every rank are kept
+  int ierr = BigMPICompat::Trace_start("trace.json", comm, 3);
+  CheckMPIFatal(ierr);
+
+  int value = 0;
+  for (unsigned int i = 0; i < 10; ++i)
+    {
+      ierr = BigMPICompat::Bcast_c(&value, 1, MPI_INT, 0, comm);
+      CheckMPIFatal(ierr);
+    }
+
+  ierr = BigMPICompat::Trace_stop();
+  CheckMPIFatal(ierr);
+
+  if (myid == 0)
+    {
+      const std::string trace = read_file("trace.json");
+      if (occurrences(trace, "\"name\":\"Bcast_c\"") != 3 * unsigned(ranks) ||
+          occurrences(trace, "(7 events dropped)") != unsigned(ranks))
+        {
+          std::cerr << "TRACE OVERFLOW WAS INVALID:\n" << trace << std::endl;
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+      std::remove("trace.json");
+    }
+
+  if (myid == 0)
+    std::cout << "TEST trace_overflow: OK" << std::endl;
+}
+
+void
+test_trace_threads()
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int      myid;
+  MPI_Comm_rank(comm, &myid);
+
+  int ierr = BigMPICompat::Trace_start("trace.json", comm, 16);
+  CheckMPIFatal(ierr);
+
+  // threads keep recording events while the trace is stopped and written
+  std::atomic<bool>        stop{false};
+  std::vector<std::thread> workers;
+  for (unsigned int i = 0; i < 4; ++i)
+    workers.emplace_back([&stop]() {
+      while (!stop)
+        {
+          MPI_COMPAT_TRACE_SCOPE("worker");
+        }
+    });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  ierr = BigMPICompat::Trace_stop();
+  CheckMPIFatal(ierr);
+  stop = true;
+  for (std::thread &worker : workers)
+    worker.join();
+
+  if (myid == 0)
+    {
+      const std::string trace = read_file("trace.json");
+      if (occurrences(trace, "\"name\":\"worker\"") == 0 ||
+          trace.compare(trace.size() - 3, 3, "]}\n") != 0)
+        {
+          std::cerr << "TRACE FROM THREADS WAS INVALID:\n"
+                    << trace << std::endl;
+          MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+      std::remove("trace.json");
+    }
+
+  if (myid == 0)
+    std::cout << "TEST trace_threads: OK" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+
+  int myid, ranks;
+  MPI_Comm_rank(MPI_COMM_WORLD, &myid);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  assert(ranks >= 2);
+
+  test_trace();
+  test_trace_overflow();
+  if (provided == MPI_THREAD_MULTIPLE)
+    test_trace_threads();
+  else if (myid == 0)
+    std::cout << "TEST trace_threads: skipped, MPI_THREAD_MULTIPLE "
+              << "is not supported" << std::endl;
+
+  MPI_Finalize();
+  return 0;
+}